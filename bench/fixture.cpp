@@ -0,0 +1,162 @@
+#include "fixture.h"
+#include "slob_writer.h"
+#include <unordered_set>
+#include <stdexcept>
+
+static const char *SYLLABLES[] = {
+    "ba", "ka", "lo", "mi", "ne", "ro", "su", "te", "vi", "zo",
+    "qu", "ph", "ch", "é", "ü", "ñ", "ст", "ов", "a", "e",
+};
+#define SYLLABLE_COUNT (sizeof(SYLLABLES) / sizeof(SYLLABLES[0]))
+
+static const char *CATEGORIES[] = {
+    "Animals", "Astronomy", "Chemistry", "Geography",
+    "History", "Languages", "Mathematics", "People",
+};
+#define CATEGORY_COUNT (sizeof(CATEGORIES) / sizeof(CATEGORIES[0]))
+#define SUBCATEGORY_COUNT 64
+
+// Mixed into the uuid, so fixtures of an older
+// generator are regenerated.
+#define FIXTURE_VERSION 2
+
+#define MIME_FIXTURE_HTML "text/html;charset=utf-8"
+#define MIME_FIXTURE_TEXT "text/plain;charset=utf-8"
+
+// Deterministic on every platform, unlike the
+// standard library's distributions.
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+class Random {
+public:
+    Random(uint64_t seed) : m_state(seed) {}
+
+    uint64_t next() { return m_state = splitmix64(m_state); }
+    // Uniform in [0, bound).
+    uint64_t below(uint64_t bound) { return next() % bound; }
+
+private:
+    uint64_t m_state;
+};
+
+static std::string word(Random &random, int syllables)
+{
+    std::string word;
+    for (int i = 0; i < syllables; i++)
+        word += SYLLABLES[random.below(SYLLABLE_COUNT)];
+    return word;
+}
+
+SLOBFixture::SLOBFixture(const SLOBFixtureOptions &options)
+    : m_options(options)
+{
+    std::unordered_set<std::string> seen;
+    m_keys.reserve(options.keys);
+    for (uint64_t attempt = 0; m_keys.size() < options.keys; attempt++) {
+        std::string candidate = key(attempt);
+        if (seen.insert(candidate).second)
+            m_keys.push_back(std::move(candidate));
+    }
+}
+
+std::string SLOBFixture::key(uint64_t index) const
+{
+    Random random(splitmix64(m_options.seed) ^ index);
+
+    if (m_options.distribution == KEYS::PREFIXED) {
+        Random subcategory(random.below(SUBCATEGORY_COUNT));
+        return std::string("Category:") + CATEGORIES[random.below(CATEGORY_COUNT)] + "/" +
+               word(subcategory, 4) + "/" + word(random, 1 + random.below(5));
+    }
+
+    std::string key = word(random, 1 + random.below(5));
+    if (random.below(5) == 0)
+        key += " " + word(random, 1 + random.below(3));
+    // Only ASCII syllables are capitalized; the
+    // others start with a multi-byte sequence.
+    if (random.below(10) == 0 && (unsigned char)key[0] < 0x80)
+        key[0] = toupper(key[0]);
+    return key;
+}
+
+std::string SLOBFixture::item(uint64_t index, const std::string &key) const
+{
+    Random random(splitmix64(m_options.seed + 1) ^ index);
+    size_t size = m_options.item_size / 2 + random.below(m_options.item_size + 1);
+
+    std::string content = "<h1>" + key + "</h1><p>";
+    while (content.size() < size) {
+        const std::string &other = m_keys[random.below(m_keys.size())];
+        content += random.below(8) ? word(random, 1 + random.below(4)) : "<b>" + other + "</b>";
+        content += ' ';
+    }
+    content += "</p>";
+    return content;
+}
+
+std::string SLOBFixture::path(const std::string &directory) const
+{
+    static const char *DISTRIBUTIONS[] = { "words", "prefixed" };
+    return directory + "/fixture-" + std::to_string(m_options.keys) + "-" +
+           DISTRIBUTIONS[m_options.distribution] + "-" + std::to_string(m_options.item_size) + "-" +
+           std::to_string(m_options.bin_item_count) + "-" + std::to_string(m_options.bin_size) + "-" +
+           (m_options.compression.empty() ? "none" : m_options.compression) + "-" +
+           std::to_string(m_options.seed) + ".slob";
+}
+
+void SLOBFixture::generate(const std::string &path) const
+{
+    uint64_t hash = splitmix64(m_options.seed ^ FIXTURE_VERSION);
+    hash = splitmix64(hash ^ m_options.keys);
+    hash = splitmix64(hash ^ m_options.distribution);
+    hash = splitmix64(hash ^ m_options.item_size);
+    hash = splitmix64(hash ^ m_options.bin_item_count);
+    hash = splitmix64(hash ^ m_options.bin_size);
+    for (char c : m_options.compression)
+        hash = splitmix64(hash ^ (unsigned char)c);
+
+    std::string uuid(16, '\0');
+    for (int i = 0; i < 16; i++)
+        uuid[i] = (hash = splitmix64(hash));
+
+    try {
+        SLOBReader existing;
+        existing.open_file(path.c_str(), REFERENCES::LAZY);
+        if (existing.uuid() == uuid)
+            return;
+    } catch (const std::exception &) {
+    }
+
+    SLOBThreadPool pool;
+    SLOBWriter writer(path.c_str(), m_options.compression, &pool);
+    writer.set_uuid(uuid);
+    writer.set_bin_item_count(m_options.bin_item_count);
+    writer.set_bin_size(m_options.bin_size);
+    writer.tag("label", "Benchmark fixture");
+
+    Random random(splitmix64(m_options.seed + 2));
+    for (uint64_t i = 0; i < m_keys.size(); i++) {
+        const char *content_type = random.below(8) ? MIME_FIXTURE_HTML : MIME_FIXTURE_TEXT;
+        U_INT id = writer.add_item(item(i, m_keys[i]), content_type);
+        writer.add_reference(m_keys[i], id);
+        if (random.below(10) == 0)
+            writer.add_reference(m_keys[i] + " (alias)", id);
+    }
+    writer.finalize();
+}
+
+std::vector<std::string> SLOBFixture::missing_keys(size_t count) const
+{
+    // Digits never occur in generated keys.
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        keys.push_back(m_keys[i % m_keys.size()] + std::to_string(i));
+    return keys;
+}
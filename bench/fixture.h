@@ -0,0 +1,61 @@
+// Synthetic SLOB files for benchmarks
+#ifndef _FIXTURE_H
+#define _FIXTURE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "slob.h"
+
+// Shapes of generated keys.
+//
+// WORDS are random words of one to five syllables, some
+// with a second word. PREFIXED keys share long hierarchical
+// prefixes ("Category:Animals/Bi..."), which makes collation
+// compare many equal bytes before telling keys apart.
+namespace KEYS {
+enum DISTRIBUTION {
+    WORDS,
+    PREFIXED,
+};
+}
+
+struct SLOBFixtureOptions {
+    U_INT keys { 100000 };
+    KEYS::DISTRIBUTION distribution { KEYS::WORDS };
+    // Mean item content size, in bytes.
+    size_t item_size { 1024 };
+    U_INT bin_item_count { (U_INT)MAX_BIN_ITEM_COUNT };
+    size_t bin_size { 512 << 10 };
+    std::string compression { DEFAULT_COMPRESSION };
+    uint64_t seed { 1 };
+};
+
+// Deterministic SLOB file: the same options always give the same
+// keys, items and uuid. Every key refers to its own item, and a
+// tenth of the keys have an alias.
+class SLOBFixture {
+public:
+    SLOBFixture(const SLOBFixtureOptions &);
+
+    // Path of the fixture in the directory, named after its options.
+    std::string path(const std::string &directory) const;
+
+    // Write the fixture, unless the path already holds it.
+    void generate(const std::string &path) const;
+
+    // Keys present in the fixture, in generation order.
+    const std::vector<std::string> &keys() const { return m_keys; }
+
+    // Keys that are not in the fixture.
+    std::vector<std::string> missing_keys(size_t count) const;
+
+private:
+    std::string key(uint64_t) const;
+    std::string item(uint64_t, const std::string &key) const;
+
+    SLOBFixtureOptions m_options;
+    std::vector<std::string> m_keys;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <sys/resource.h>
+#include <benchmark/benchmark.h>
+#include "slob.h"
+#include "dictionary.h"
+#include "collation_index.h"
+#include "bloom_filter.h"
+#include "fixture.h"
+
+// Lookups timed per benchmark repetition before
+// percentiles are taken.
+#define LOOKUP_SAMPLES (1 << 16)
+
+static SLOBFixtureOptions options;
+static std::string directory = ".";
+static std::unique_ptr<SLOBFixture> fixture;
+static std::string fixture_path;
+
+// Peak resident set size of the process so far, in MiB. It only
+// grows, so it is cumulative over the benchmarks run before; run
+// one benchmark per process (--benchmark_filter) for its own peak.
+static double peak_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+static void report_rss(benchmark::State &state)
+{
+    state.counters["cumulative_peak_rss_mb"] = peak_rss();
+}
+
+// Nanosecond percentile of sorted samples.
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+// Args: reference loading, backend.
+static void BM_OpenFile(benchmark::State &state)
+{
+    auto loading = (REFERENCES::LOADING)state.range(0);
+    auto backend = (BACKEND::TYPE)state.range(1);
+
+    for (auto _ : state) {
+        SLOBReader reader;
+        reader.open_file(fixture_path.c_str(), loading, backend);
+        benchmark::DoNotOptimize(reader.ref_count());
+    }
+
+    state.SetLabel(std::string(loading == REFERENCES::EAGER ? "eager" : "lazy") + "/" +
+                   (backend == BACKEND::STREAM ? "stream" : "mmap"));
+    report_rss(state);
+}
+BENCHMARK(BM_OpenFile)
+    ->ArgsProduct({ { REFERENCES::EAGER, REFERENCES::LAZY }, { BACKEND::STREAM, BACKEND::MMAP } })
+    ->Unit(benchmark::kMillisecond);
+
+// Args: whether the looked up keys exist, whether the
+// collation index and filter are open.
+static void BM_Lookup(benchmark::State &state)
+{
+    bool hits = state.range(0);
+    bool indexed = state.range(1);
+
+    SLOBReader reader;
+    reader.open_file(fixture_path.c_str());
+    SLOBDict dict(reader);
+
+    if (indexed) {
+        std::string index_path = fixture_path + COLLATION_INDEX_EXTENSION;
+        std::string filter_path = fixture_path + BLOOM_FILTER_EXTENSION;
+        CollationKeyList key_list(reader);
+        try {
+            dict.open_index(index_path.c_str());
+        } catch (const std::exception &) {
+            SLOBCollationIndex::build(reader, key_list, index_path.c_str());
+            dict.open_index(index_path.c_str());
+        }
+        try {
+            dict.open_filter(filter_path.c_str());
+        } catch (const std::exception &) {
+            SLOBBloomFilter::build(reader, key_list, filter_path.c_str());
+            dict.open_filter(filter_path.c_str());
+        }
+    }
+
+    const std::vector<std::string> keys = hits ? fixture->keys() : fixture->missing_keys(LOOKUP_SAMPLES);
+    std::vector<double> samples;
+    samples.reserve(LOOKUP_SAMPLES);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        // Stride through the keys, so consecutive
+        // lookups land far apart.
+        const std::string &key = keys[next];
+        next = (next + 7919) % keys.size();
+
+        auto start = std::chrono::steady_clock::now();
+        auto matches = dict[key];
+        auto end = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(matches.data());
+
+        if (samples.size() < LOOKUP_SAMPLES)
+            samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+    state.counters["p50_ns"] = percentile(samples, 0.50);
+    state.counters["p99_ns"] = percentile(samples, 0.99);
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(hits ? "hit" : "miss") + (indexed ? "/indexed" : ""));
+    report_rss(state);
+}
+BENCHMARK(BM_Lookup)->ArgsProduct({ { 1, 0 }, { 0, 1 } });
+
+// Arg: bin cache budget, in MiB.
+static void BM_Item(benchmark::State &state)
+{
+    SLOBReader reader;
+    reader.open_file(fixture_path.c_str());
+    reader.set_bin_cache_size((size_t)state.range(0) << 20);
+
+    size_t next = 0;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        SLOBReferenceView ref = reader.reference_view(next);
+        next = (next + 7919) % reader.ref_count();
+
+        std::string content = reader.item(ref.bin_index, ref.item_index);
+        bytes += content.size();
+        benchmark::DoNotOptimize(content.data());
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations());
+    SLOBCacheStats stats = reader.bin_cache_stats();
+    if (stats.hits + stats.misses)
+        state.counters["bin_cache_hit_rate"] = (double)stats.hits / (stats.hits + stats.misses);
+    report_rss(state);
+}
+BENCHMARK(BM_Item)->Arg(0)->Arg(16)->Arg(256);
+
+// Arg: pool threads, or 0 to scan on the calling thread.
+static void BM_ForEachItem(benchmark::State &state)
+{
+    SLOBReader reader;
+    reader.open_file(fixture_path.c_str());
+    size_t threads = state.range(0);
+    std::unique_ptr<SLOBThreadPool> pool;
+    if (threads)
+        pool = std::make_unique<SLOBThreadPool>(threads);
+
+    size_t bytes = 0;
+    size_t items = 0;
+    for (auto _ : state) {
+        auto call = [&](const auto &item) {
+            bytes += item.content.size();
+            items++;
+            return ITERATION::CONTINUE;
+        };
+        if (pool)
+            reader.for_each_item(call, *pool);
+        else
+            reader.for_each_item(call);
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(items);
+    report_rss(state);
+}
+// Pool callbacks leave the calling thread idle, so the
+// scan is timed by the wall clock.
+BENCHMARK(BM_ForEachItem)
+    ->Apply([](benchmark::internal::Benchmark *benchmark) {
+        benchmark->Arg(0)->Arg(1);
+        if (std::thread::hardware_concurrency() > 1)
+            benchmark->Arg(std::thread::hardware_concurrency());
+    })
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [fixture options] [benchmark options]\n"
+              << "\n"
+              << "  --fixture_keys=<count>            (default: " << options.keys << ")\n"
+              << "  --fixture_distribution=words|prefixed\n"
+              << "  --fixture_item_size=<bytes>       (default: " << options.item_size << ")\n"
+              << "  --fixture_bin_items=<count>       (default: " << options.bin_item_count << ")\n"
+              << "  --fixture_bin_size=<bytes>        (default: " << options.bin_size << ")\n"
+              << "  --fixture_compression=lzma2|zlib|none\n"
+              << "  --fixture_seed=<seed>             (default: " << options.seed << ")\n"
+              << "  --fixture_dir=<directory>         (default: .)\n"
+              << "\n"
+              << "Fixtures are generated on first use, and kept for later runs.\n"
+              << "Use --benchmark_format=json or --benchmark_out=<file> for\n"
+              << "machine-readable results.\n";
+}
+
+// Consume a --fixture_<name>=<value> argument.
+static bool fixture_flag(const char *arg, const char *name, std::string &value)
+{
+    std::string prefix = std::string("--fixture_") + name + "=";
+    if (strncmp(arg, prefix.c_str(), prefix.size()) != 0)
+        return false;
+    value = arg + prefix.size();
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (fixture_flag(argv[i], "keys", value)) {
+            options.keys = std::stoul(value);
+        } else if (fixture_flag(argv[i], "distribution", value)) {
+            if (value != "words" && value != "prefixed") {
+                usage(argv[0]);
+                return 1;
+            }
+            options.distribution = value == "words" ? KEYS::WORDS : KEYS::PREFIXED;
+        } else if (fixture_flag(argv[i], "item_size", value)) {
+            options.item_size = std::stoull(value);
+        } else if (fixture_flag(argv[i], "bin_items", value)) {
+            options.bin_item_count = std::stoul(value);
+        } else if (fixture_flag(argv[i], "bin_size", value)) {
+            options.bin_size = std::stoull(value);
+        } else if (fixture_flag(argv[i], "compression", value)) {
+            options.compression = value == "none" ? "" : value;
+        } else if (fixture_flag(argv[i], "seed", value)) {
+            options.seed = std::stoull(value);
+        } else if (fixture_flag(argv[i], "dir", value)) {
+            directory = value;
+        } else if (!strcmp(argv[i], "--help")) {
+            usage(argv[0]);
+            benchmark::PrintDefaultHelp();
+            return 0;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    try {
+        fixture = std::make_unique<SLOBFixture>(options);
+        fixture_path = fixture->path(directory);
+        fixture->generate(fixture_path);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    benchmark::AddCustomContext("fixture", fixture_path);
+    benchmark::AddCustomContext("fixture_keys", std::to_string(options.keys));
+    benchmark::AddCustomContext("fixture_compression",
+                                options.compression.empty() ? "none" : options.compression);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Asynchronous SLOB item retrieval
+#ifndef _ASYNC_READER_H
+#define _ASYNC_READER_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include "slob.h"
+
+// Bins read and decompressed at once, per reader.
+#define DEFAULT_ASYNC_QUEUE_DEPTH 32
+
+// Runs item completions, e.g. by posting them to an event loop.
+typedef std::function<void(std::function<void()>)> SLOBExecutor;
+
+// Called with the item view, or the exception that failed it.
+// Exceptions thrown by the callback are caught and dropped.
+typedef std::function<void(SLOBItemView, std::exception_ptr)> SLOBItemCallback;
+
+// Retrieves items without blocking the caller. Cached bins complete
+// at once; other bins are read and decompressed, at most queue depth
+// bins at a time, so many outstanding requests pipeline their reads
+// while the rest wait their turn in order. Requests for a bin already
+// queued or in flight share its read.
+//
+// When built with liburing (SLOB_IO_URING), bins of unmapped files
+// are read through an io_uring, so reads in flight are not bounded
+// by the pool size, and only decompressed on the pool. Otherwise, or
+// if the ring cannot be set up, bins are read on the pool. If the ring
+// fails later, its reads in flight fail, and later bins are read on
+// the pool.
+//
+// Completions run on the executor, or on the pool thread that read
+// the bin without one. The reader must outlive this object, which
+// waits for the bins in flight when destroyed.
+class SLOBAsyncReader {
+public:
+    SLOBAsyncReader(const SLOBReader &, SLOBThreadPool &, SLOBExecutor = nullptr,
+                    size_t queue_depth = DEFAULT_ASYNC_QUEUE_DEPTH);
+    ~SLOBAsyncReader();
+
+    SLOBAsyncReader(const SLOBAsyncReader &) = delete;
+    SLOBAsyncReader &operator=(const SLOBAsyncReader &) = delete;
+
+    void set_queue_depth(size_t);
+
+    // Request an item, completing through the executor.
+    void item(U_INT, U_SHORT, SLOBItemCallback);
+
+    // Request an item as a future. Futures are fulfilled on
+    // the pool, not the executor, so waiting on one from the
+    // executor's thread cannot deadlock.
+    std::future<SLOBItemView> item(U_INT, U_SHORT);
+
+    // Bins queued or in flight.
+    size_t pending() const;
+
+private:
+    struct Request {
+        U_SHORT item_index;
+        SLOBItemCallback callback;
+        bool executor;
+    };
+
+    // Reads submitted to an io_uring (defined with SLOB_IO_URING).
+    struct Ring;
+
+    void request(U_INT, U_SHORT, SLOBItemCallback, bool executor);
+    // Read a bin, and decompress it on the pool.
+    void start(U_INT);
+    // Read a bin through the ring, if it can take it.
+    bool start_ring_read(U_INT);
+    // Decompress a bin read through the ring on the pool.
+    void decode(U_INT, std::string, std::exception_ptr);
+    // Hand a read bin to its requests, and start the next bin.
+    void finish(U_INT, std::shared_ptr<const SLOBStoreItem>, std::exception_ptr);
+    // Take queued bins into free slots, with the lock held.
+    std::vector<U_INT> dequeue();
+    // No bin queued, in flight or completing, with the lock held.
+    bool idle() const;
+    void complete(Request &, const std::shared_ptr<const SLOBStoreItem> &, std::exception_ptr) const;
+
+    const SLOBReader &m_reader;
+    SLOBThreadPool &m_pool;
+    SLOBExecutor m_executor;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    size_t m_queue_depth;
+    size_t m_in_flight { 0 };
+    // Bins read, whose requests are being completed.
+    size_t m_completing { 0 };
+    // Requests of every queued or in flight bin.
+    std::unordered_map<U_INT, std::vector<Request>> m_requests;
+    // Bins waiting for a free slot, in request order.
+    std::deque<U_INT> m_queue;
+
+    // Destroyed first, once no read is in flight.
+    std::unique_ptr<Ring> m_ring;
+};
+
+#endif
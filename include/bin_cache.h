@@ -0,0 +1,74 @@
+// Cache of decompressed SLOB store items
+#ifndef _BIN_CACHE_H
+#define _BIN_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+struct SLOBStoreItem;
+
+// Bins remembered as missed once, for SLOBBinCache::admit().
+#define BIN_CACHE_ADMISSION_HISTORY 4096
+
+struct SLOBCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+// Least recently used cache of decompressed bins, keyed by
+// bin index and bounded by a budget in bytes. A budget of 0
+// disables the cache. All members can be called concurrently.
+class SLOBBinCache {
+public:
+    SLOBBinCache(size_t budget = 0);
+
+    void set_budget(size_t);
+    size_t budget() const;
+
+    // Cached bin, or nullptr (counted as a miss).
+    std::shared_ptr<const SLOBStoreItem> get(uint32_t);
+
+    // Insert a bin, evicting the least recently used bins
+    // to stay within the budget.
+    void put(uint32_t, std::shared_ptr<const SLOBStoreItem>);
+
+    // Whether a bin is worth decompressing whole for one item:
+    // it is cached, or missed recently before. Otherwise the
+    // miss is counted and remembered, and false returned.
+    bool admit(uint32_t);
+
+    SLOBCacheStats stats() const;
+    // Drop every bin, and reset the statistics.
+    void clear();
+
+private:
+    struct Entry {
+        uint32_t bin_index;
+        std::shared_ptr<const SLOBStoreItem> item;
+        size_t bytes;
+    };
+
+    void evict(size_t budget);
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> m_index;
+    size_t m_budget;
+    size_t m_bytes { 0 };
+
+    // Bins missed once by admit(), most recent first.
+    std::list<uint32_t> m_missed;
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> m_missed_index;
+
+    uint64_t m_hits { 0 };
+    uint64_t m_misses { 0 };
+    uint64_t m_evictions { 0 };
+};
+
+#endif
@@ -0,0 +1,51 @@
+// Approximate membership filter of dictionary keys
+#ifndef _BLOOM_FILTER_H
+#define _BLOOM_FILTER_H
+
+#include <string>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+
+#define BLOOM_FILTER_MAGIC "SLOBBLOM"
+#define BLOOM_FILTER_EXTENSION ".bloom"
+#define BLOOM_FILTER_BITS_PER_ENTRY 10
+#define BLOOM_FILTER_HASHES 7
+// Bits per block; every lookup reads one block.
+#define BLOOM_FILTER_BLOCK_BITS 512
+// Shortest sort key prefix in the filter. Longer ones double in
+// length, up to BLOOM_FILTER_MIN_PREFIX << (BLOOM_FILTER_LEVELS - 1).
+#define BLOOM_FILTER_MIN_PREFIX 4
+#define BLOOM_FILTER_LEVELS 5
+
+class CollationKeyList;
+
+// Blocked Bloom filter of the primary strength sort key prefixes of
+// every key. Lookups match keys by sort key prefix, so each key adds
+// its prefixes of 4, 8, ... 64 bytes, and a lookup checks the longest
+// of these lengths within its own sort key. A miss means no key
+// matches; lookups with shorter sort keys cannot use the filter.
+class SLOBBloomFilter {
+public:
+    static void build(const SLOBReader &, const CollationKeyList &, const char *path);
+
+    // Map a filter built for the reader's file. Throws if the filter
+    // is stale or was built with another collator version, leaving
+    // the filter closed.
+    void open(const char *path, const SLOBReader &, const CollationKeyList &);
+
+    bool is_open() const { return m_open; }
+
+    // Whether a key might start with the sort key prefix
+    // (without its terminator). False is definite.
+    bool may_contain(std::string_view) const;
+
+private:
+    SLOBSidecar m_sidecar;
+    bool m_open { false };
+    U_INT m_block_count { 0 };
+    U_INT m_hash_count { BLOOM_FILTER_HASHES };
+    const char *m_blocks { nullptr };
+};
+
+#endif
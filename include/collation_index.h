@@ -0,0 +1,79 @@
+// Precomputed collation key index
+#ifndef _COLLATION_INDEX_H
+#define _COLLATION_INDEX_H
+
+#include <string>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+
+#define COLLATION_INDEX_MAGIC "SLOBKEYS"
+#define COLLATION_INDEX_EXTENSION ".keys"
+// Entries between two fully stored keys.
+#define COLLATION_INDEX_RESTART_INTERVAL 16
+
+class CollationKeyList;
+
+// Primary strength sort keys of every reference, in collation order.
+// Keys are prefix-compressed against the previous key, restarting
+// with a complete key every COLLATION_INDEX_RESTART_INTERVAL entries
+// so a lookup can binary search the restart points.
+class SLOBCollationIndex {
+public:
+    class Cursor {
+    public:
+        bool valid() const { return m_position < m_index->m_count; }
+        // Sort key of the current entry, without its terminator.
+        std::string_view sort_key() const { return m_key; }
+        U_INT reference() const { return m_reference; }
+        // Position of the current entry in the index.
+        U_INT position() const { return m_position; }
+        void next();
+
+    private:
+        friend class SLOBCollationIndex;
+
+        Cursor(const SLOBCollationIndex *, U_INT block);
+        void decode();
+
+        const SLOBCollationIndex *m_index;
+        U_INT m_position;
+        size_t m_offset;
+        std::string m_key;
+        U_INT m_reference { 0 };
+    };
+
+    // Compute the sort key of every reference and write the index to path.
+    static void build(const SLOBReader &, const CollationKeyList &, const char *path);
+
+    // Map an index built for the reader's file. Throws if the index
+    // is stale or was built with another collator version, leaving
+    // the index closed.
+    void open(const char *path, const SLOBReader &, const CollationKeyList &);
+
+    bool is_open() const { return m_open; }
+    U_INT size() const { return m_count; }
+
+    Cursor begin() const;
+    Cursor at(U_INT position) const;
+    // First entry whose sort key does not collate
+    // before the given sort key prefix.
+    Cursor lower_bound(std::string_view) const;
+
+    // Compare a sort key (truncated to the prefix length) with a prefix.
+    static int compare(std::string_view, std::string_view);
+
+private:
+    U_LONG_LONG block_offset(U_INT) const;
+    std::string_view block_key(U_INT) const;
+
+    SLOBSidecar m_sidecar;
+    bool m_open { false };
+    U_INT m_count { 0 };
+    U_INT m_restart_interval { COLLATION_INDEX_RESTART_INTERVAL };
+    U_INT m_block_count { 0 };
+    std::string_view m_block_offsets;
+    std::string_view m_entries;
+};
+
+#endif
@@ -0,0 +1,29 @@
+// Shared collator for SLOB key lookups
+#ifndef _COLLATOR_H
+#define _COLLATOR_H
+
+#include <memory>
+#include <unicode/coll.h>
+
+U_NAMESPACE_USE
+
+// Root locale collator at primary strength, with shifted alternate
+// characters: the lookup configuration of every SLOB dictionary. It
+// is created once per process, and each thread works with its own
+// clone, so sort keys can be computed concurrently. ICU is never
+// cleaned up, as other dictionaries may still be using it.
+class SLOBCollator {
+public:
+    // Collator of the calling thread.
+    static const Collator &get();
+
+    // Collator of the calling thread at identical strength,
+    // which orders the keys of SLOB files.
+    static const Collator &sorting();
+
+private:
+    static const Collator &prototype(Collator::ECollationStrength);
+    static const Collator &clone(const Collator &, std::unique_ptr<Collator> &);
+};
+
+#endif
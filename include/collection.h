@@ -0,0 +1,85 @@
+// Lookups across many SLOB files
+#ifndef _COLLECTION_H
+#define _COLLECTION_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include "slob.h"
+#include "dictionary.h"
+
+// Reference found in one dictionary of a collection.
+struct SLOBCollectionMatch {
+    // Index and uuid of the dictionary.
+    size_t dictionary;
+    std::string uuid;
+    SLOBReference reference;
+};
+
+// A page of prefix search results across a collection. Passing
+// next to the following search continues after this page.
+struct SLOBCollectionPage {
+    std::vector<SLOBCollectionMatch> matches;
+    std::vector<U_INT> next;
+    bool complete;
+};
+
+// Dictionaries searched together. Every dictionary is searched
+// (in parallel on the pool, if given), and the results merged in
+// collation order, then in the order the dictionaries were opened.
+class SLOBCollection {
+public:
+    SLOBCollection(SLOBThreadPool * = nullptr);
+
+    // Open a SLOB file, and its collation index and filter if
+    // they exist beside it. Returns the index of the dictionary.
+    size_t open_file(const char *, REFERENCES::LOADING = REFERENCES::EAGER,
+                     BACKEND::TYPE = BACKEND::STREAM);
+
+    size_t size() const { return m_dictionaries.size(); }
+    SLOBReader &reader(size_t index) { return *m_dictionaries.at(index).reader; }
+    SLOBDict &dict(size_t index) { return *m_dictionaries.at(index).dict; }
+
+    // Search every dictionary for key.
+    std::vector<SLOBCollectionMatch> operator[](const std::string &term);
+
+    // Up to limit references across the collection whose keys
+    // start with prefix, from the cursor of a previous page.
+    SLOBCollectionPage prefix_search(const std::string &prefix, size_t limit,
+                                     const std::vector<U_INT> &cursor = {});
+
+private:
+    struct Dictionary {
+        std::unique_ptr<SLOBReader> reader;
+        std::unique_ptr<SLOBDict> dict;
+    };
+
+    // Match of one dictionary, with its merge key.
+    struct Candidate {
+        std::string sort_key;
+        U_INT position;
+        SLOBReference reference;
+    };
+
+    // Matches of one dictionary, the position following
+    // them, and whether more matches follow.
+    struct Result {
+        std::vector<Candidate> candidates;
+        U_INT next;
+        bool more;
+    };
+
+    // Up to limit matches of every dictionary (all if 0),
+    // from the cursor.
+    std::vector<Result> search(const std::string &, size_t, const std::vector<U_INT> &);
+    // Merge the results in collation order, up to limit
+    // matches (all if 0). Counts the matches taken from
+    // each dictionary.
+    std::vector<SLOBCollectionMatch> merge(const std::vector<Result> &, size_t,
+                                           std::vector<size_t> &) const;
+
+    SLOBThreadPool *m_pool;
+    std::vector<Dictionary> m_dictionaries;
+};
+
+#endif
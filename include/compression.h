@@ -3,11 +3,42 @@
 
 #include <string>
 #include <map>
+#include <functional>
+#include <string_view>
 
-typedef std::string (*decompress_function)(const std::string &);
+// Given the output decompressed so far, returns the total
+// output size needed. Decompression stops once it is reached.
+typedef std::function<size_t(std::string_view)> decompress_limit;
 
-// DECOMPRESSION FUNCTIONS
-// COMPRESSION.at(<compression type>)
-extern const std::map<std::string, decompress_function> COMPRESSION;
+// Compressor and decompressor for one compression type. Decoder
+// state is kept per thread and reused between calls, so a codec
+// can be used from many threads at once.
+class SLOBCodec {
+public:
+    virtual ~SLOBCodec() {}
+
+    virtual const char *name() const = 0;
+
+    // Decompress into out, replacing its contents. The output is
+    // decoded in place, reusing out's capacity; when it is smaller
+    // than an estimate from earlier calls, it is grown before
+    // decoding. With a limit, decoding stops early.
+    virtual void decompress(std::string_view in, std::string &out,
+                            const decompress_limit *limit = nullptr) const = 0;
+
+    // Compress into out, replacing its contents.
+    virtual void compress(std::string_view in, std::string &out) const = 0;
+
+    std::string decompress(std::string_view in) const
+    {
+        std::string out;
+        decompress(in, out);
+        return out;
+    }
+};
+
+// COMPRESSION CODECS
+// COMPRESSION.at(<compression type>)->decompress(...)
+extern const std::map<std::string, const SLOBCodec *> COMPRESSION;
 
 #endif
@@ -2,20 +2,27 @@
 #define _DICT_H
 
 #include <vector>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unicode/coll.h>
 #include <unicode/utf8.h>
-#include <unicode/uclean.h>
 #include <unicode/sortkey.h>
 #include <unicode/errorcode.h>
 #include "slob.h"
+#include "collator.h"
+#include "collation_index.h"
+#include "fuzzy_index.h"
+#include "substring_index.h"
+#include "bloom_filter.h"
+
+U_NAMESPACE_USE
 
 #define MAX_SORTKEY_LEN 256
 
 class CollationKeyList {
 public:
     CollationKeyList(SLOBReader &);
-    ~CollationKeyList();
 
     // Set max collation key comparison length.
     // By default, this is 256 characters.
@@ -25,10 +32,22 @@ public:
     template <typename C>
     void for_each_key(C);
 
-    Collator *collator() const;
+    // Write the sort key of a UTF-8 string to the buffer,
+    // truncated to the max collation key comparison length.
+    // Returns the length of the complete sort key.
+    int32_t sort_key(std::string_view, uint8_t *) const;
+
+    // Complete sort key of a UTF-8 string, without its terminator.
+    std::string sort_key(std::string_view) const;
+
+    // Compare the (truncated) sort key of a UTF-8 string
+    // against another sort key of the given length.
+    int compare(std::string_view, const uint8_t *, int32_t) const;
+
+    // The calling thread's collator (see SLOBCollator).
+    const Collator *collator() const;
 
 private:
-    Collator *m_collator;
     SLOBReader &m_slob_reader;
     int32_t m_maxlength { MAX_SORTKEY_LEN };
 };
@@ -36,12 +55,9 @@ private:
 template <typename C>
 void CollationKeyList::for_each_key(C call)
 {
-    uint8_t *sortkey = new uint8_t[MAX_SORTKEY_LEN];
+    uint8_t *sortkey = new uint8_t[m_maxlength];
     m_slob_reader.for_each_reference([&](auto &ref) {
-        UChar u_content[ref.key.length()+1];
-        u_charsToUChars(ref.key.c_str(), u_content, ref.key.length()+1);
-        UnicodeString u_string(u_content);
-        m_collator->getSortKey(u_string, sortkey, m_maxlength-1);
+        sort_key(ref.key, sortkey);
         if (call(sortkey, ref))
             return ITERATION::BREAK;
         return ITERATION::CONTINUE;
@@ -49,6 +65,66 @@ void CollationKeyList::for_each_key(C call)
     delete[] sortkey;
 }
 
+// A page of prefix search results. Passing next to the
+// following search continues after this page.
+struct SLOBSearchPage {
+    std::vector<SLOBReference> references;
+    U_INT next;
+    bool complete;
+};
+
+// Reference within edit distance of a fuzzy search term.
+struct SLOBFuzzyMatch {
+    SLOBReference reference;
+    U_INT distance;
+};
+
+class SLOBDict;
+
+// Forward iterator over the references matching a lookup, in
+// collation order. Each match is read as the iterator reaches
+// it, and the iterator equals std::default_sentinel past the last.
+class SLOBMatchIterator {
+public:
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = SLOBReferenceView;
+    using difference_type = std::ptrdiff_t;
+
+    SLOBMatchIterator() = default;
+    SLOBMatchIterator(const SLOBDict *, std::shared_ptr<const std::string>, U_INT);
+
+    SLOBReferenceView operator*() const { return m_view; }
+
+    // Position of the match in collation order.
+    U_INT position() const { return m_position; }
+    // Sort key of the match, without its terminator.
+    std::string sort_key() const;
+
+    SLOBMatchIterator &operator++();
+    SLOBMatchIterator operator++(int);
+
+    bool operator==(const SLOBMatchIterator &other) const
+    {
+        return m_done == other.m_done && (m_done || m_position == other.m_position);
+    }
+    bool operator==(std::default_sentinel_t) const { return m_done; }
+
+private:
+    // View the reference at the current position, or
+    // finish once it is past the matches.
+    void match();
+
+    const SLOBDict *m_dict { nullptr };
+    std::shared_ptr<const std::string> m_sortkey;
+    std::optional<SLOBCollationIndex::Cursor> m_cursor;
+    U_INT m_position { 0 };
+    bool m_done { true };
+    std::shared_ptr<const SLOBReference> m_buffer;
+    SLOBReferenceView m_view {};
+};
+
+typedef SLOBRange<SLOBMatchIterator, std::default_sentinel_t> SLOBMatchRange;
+
 class SLOBDict {
 public:
     SLOBDict(SLOBReader &);
@@ -56,9 +132,53 @@ public:
     // Search SLOB references for key.
     std::vector<SLOBReference> operator[](const std::string &term);
 
+    // Lazily search SLOB references for key, from the
+    // given position in collation order.
+    SLOBMatchRange lookup(const std::string &term, U_INT start = 0) const;
+
+    // Up to limit references whose keys start with prefix,
+    // in collation order, beginning at the cursor.
+    SLOBSearchPage prefix_search(const std::string &prefix, size_t limit, U_INT cursor = 0);
+
+    // Map a collation index built by SLOBCollationIndex::build.
+    // Lookups then search the index instead of collating keys.
+    void open_index(const char *path);
+
+    // Map a filter built by SLOBBloomFilter::build. Lookups
+    // and prefix searches the filter rules out return nothing
+    // without searching.
+    void open_filter(const char *path);
+
+    // Map a fuzzy index built by SLOBFuzzyIndex::build.
+    void open_fuzzy_index(const char *path);
+
+    // References whose keys are within max_distance edits of the
+    // term, ignoring case and accents, closest first. Requires a
+    // fuzzy index.
+    std::vector<SLOBFuzzyMatch> fuzzy_search(const std::string &term, U_INT max_distance,
+                                             size_t limit = 0) const;
+
+    // Map a substring index built by SLOBSubstringIndex::build.
+    void open_substring_index(const char *path);
+
+    // References whose keys contain the term, ignoring case and
+    // accents, for at most limit keys (0 for no limit). An empty
+    // term matches nothing. Requires a substring index.
+    std::vector<SLOBReference> substring_search(const std::string &term, size_t limit = 0) const;
+
 private:
+    // Index of the first reference whose key does not
+    // collate before the given sort key prefix.
+    U_INT lower_bound(const uint8_t *, int32_t) const;
+
+    friend class SLOBMatchIterator;
+
     SLOBReader &m_slob_reader;
     CollationKeyList m_key_list;
+    SLOBCollationIndex m_index;
+    SLOBBloomFilter m_filter;
+    SLOBFuzzyIndex m_fuzzy_index;
+    SLOBSubstringIndex m_substring_index;
 };
 
 #endif
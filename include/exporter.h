@@ -0,0 +1,74 @@
+// Export of SLOB references joined to their items
+#ifndef _EXPORTER_H
+#define _EXPORTER_H
+
+#include <span>
+#include <string>
+#include <vector>
+#include <ostream>
+#include "slob.h"
+
+// Output formats for SLOBExporter.
+//
+// JSONL writes one object per reference, with key, fragment,
+// content_type and content. Content that is not valid UTF-8 is
+// base64 encoded, and marked with "encoding": "base64".
+// TSV writes key, fragment, content type and content columns,
+// escaping backslashes, tabs, newlines and carriage returns.
+namespace EXPORT {
+enum FORMAT {
+    JSONL,
+    TSV,
+};
+}
+
+// Writes every reference of a reader with the content of its item.
+// References are grouped by bin, so each bin is decompressed once
+// (on the pool, if given), and records are streamed in bin order,
+// and in collation order within a bin. At most window bins (by
+// default DEFAULT_BIN_WINDOW_PER_THREAD per pool thread) are held
+// ahead of the output, which bounds memory use.
+class SLOBExporter {
+public:
+    SLOBExporter(SLOBReader &, SLOBThreadPool * = nullptr);
+
+    void set_format(EXPORT::FORMAT);
+
+    // Only export items of these content types. A type without
+    // parameters also matches the type with parameters, so
+    // "text/html" matches "text/html;charset=utf-8".
+    void set_content_types(std::vector<std::string>);
+
+    // Only export keys collating from the first key up to, but
+    // not including, keys starting with the last. Keys compare
+    // like lookups, ignoring case and accents. An empty key
+    // leaves that end open.
+    void set_key_range(const std::string &from, const std::string &to);
+
+    void set_window(size_t);
+
+    // Write the export, and return the number of records.
+    size_t write(std::ostream &) const;
+
+private:
+    struct Chunk {
+        std::string output;
+        size_t records { 0 };
+    };
+
+    // References within the key range, as [begin, end).
+    std::pair<U_INT, U_INT> reference_range() const;
+    // Format the references of one bin.
+    Chunk export_bin(U_INT, std::span<const U_INT> references,
+                     const std::vector<bool> &content_types) const;
+
+    SLOBReader &m_reader;
+    SLOBThreadPool *m_pool;
+    EXPORT::FORMAT m_format { EXPORT::JSONL };
+    std::vector<std::string> m_content_types;
+    std::string m_from;
+    std::string m_to;
+    size_t m_window { 0 };
+};
+
+#endif
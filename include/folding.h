@@ -0,0 +1,54 @@
+// Key folding for approximate key search
+#ifndef _FOLDING_H
+#define _FOLDING_H
+
+#include <string>
+#include <utility>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+
+// Fold a UTF-8 key for approximate matching: case folded,
+// decomposed, and with combining marks removed, so "Éclair"
+// and "eclair" fold to the same key.
+std::string fold_key(std::string_view);
+
+// Distinct folded keys of a file in bytewise order, each with the
+// references whose keys fold to it. Stored at the start of the
+// fuzzy and substring index payloads.
+class SLOBFoldedKeyTable {
+public:
+    // Fold the keys of every reference.
+    void build(const SLOBReader &);
+    void write(SLOBSidecarWriter &) const;
+    // View a table at the start of a sidecar payload.
+    // Returns the size of the table in bytes.
+    size_t view(std::string_view, const SLOBReader &);
+
+    U_INT size() const { return m_key_count; }
+    std::string_view key(U_INT) const;
+    // All key bytes; each key is a slice.
+    std::string_view keys() const { return m_keys; }
+    // Key whose slice of keys() contains the byte offset.
+    U_INT key_at(U_INT) const;
+
+    // Range of reference slots [first, second) of a key.
+    std::pair<U_INT, U_INT> references(U_INT) const;
+    // Reference index in a slot.
+    U_INT reference(U_INT) const;
+
+private:
+    U_INT key_offset(U_INT) const;
+
+    // Table assembled by build().
+    std::string m_built;
+
+    U_INT m_key_count { 0 };
+    U_INT m_reference_count { 0 };
+    const char *m_key_offsets { nullptr };
+    const char *m_reference_offsets { nullptr };
+    const char *m_references { nullptr };
+    std::string_view m_keys;
+};
+
+#endif
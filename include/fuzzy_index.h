@@ -0,0 +1,51 @@
+// Approximate key search index
+#ifndef _FUZZY_INDEX_H
+#define _FUZZY_INDEX_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+#include "folding.h"
+
+#define FUZZY_INDEX_MAGIC "SLOBFUZZ"
+#define FUZZY_INDEX_EXTENSION ".fuzzy"
+
+// Index of a reference within edit distance of a fuzzy search term.
+struct SLOBFuzzyHit {
+    U_INT reference;
+    U_INT distance;
+};
+
+// Folded key table (see SLOBFoldedKeyTable). Searches walk
+// the sorted keys as a trie, computing one Levenshtein row per code
+// point, and seek past every prefix already too distant.
+class SLOBFuzzyIndex {
+public:
+    static void build(const SLOBReader &, const char *path);
+
+    // Map an index built for the reader's file. Throws if stale,
+    // leaving the index closed.
+    void open(const char *path, const SLOBReader &);
+
+    bool is_open() const { return m_open; }
+    U_INT size() const { return m_table.size(); }
+
+    // References whose folded key is within max_distance edits of
+    // the folded term, by distance and then key order. Every key is
+    // searched, as closer keys can come later; only the first limit
+    // keys (0 for no limit) are returned.
+    std::vector<SLOBFuzzyHit> search(std::string_view term, U_INT max_distance,
+                                     size_t limit = 0) const;
+
+private:
+    // First key after position begin not starting with the prefix.
+    U_INT skip_prefix(U_INT begin, std::string_view) const;
+
+    SLOBSidecar m_sidecar;
+    bool m_open { false };
+    SLOBFoldedKeyTable m_table;
+};
+
+#endif
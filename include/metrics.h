@@ -0,0 +1,147 @@
+// Read path metrics and tracing
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// Counters, by the event they count.
+namespace METRIC {
+enum COUNTER {
+    FILES_OPENED,
+    LOOKUPS,
+    LOOKUP_MATCHES,
+    // Lookups a filter answered without searching.
+    LOOKUPS_FILTERED,
+    // Collation key comparisons made while searching.
+    KEY_COMPARISONS,
+    // References decoded from the file after opening it.
+    REFERENCE_READS,
+    BIN_READS,
+    FILE_READS,
+    BYTES_READ,
+    // Bytes read or viewed in mapped files.
+    BYTES_MAPPED,
+    COMPRESSED_BYTES_LZMA2,
+    COMPRESSED_BYTES_ZLIB,
+    COMPRESSED_BYTES_NONE,
+    DECOMPRESSED_BYTES_LZMA2,
+    DECOMPRESSED_BYTES_ZLIB,
+    DECOMPRESSED_BYTES_NONE,
+    BIN_CACHE_HITS,
+    BIN_CACHE_MISSES,
+    BIN_CACHE_EVICTIONS,
+    COUNTER_COUNT,
+};
+
+// Latency histograms, by the operation they time.
+enum HISTOGRAM {
+    OPEN_FILE,
+    PARSE_HEADER,
+    READ_REFERENCE_POSITIONS,
+    READ_REFERENCES,
+    READ_STORE_ITEM_POSITIONS,
+    // Complete lookups (SLOBDict::operator[]).
+    LOOKUP,
+    // Sort key of a lookup term (collation).
+    SORT_KEY,
+    // Positional read from an unmapped file.
+    FILE_READ,
+    // Locating and reading one compressed bin.
+    BIN_READ,
+    DECOMPRESS_LZMA2,
+    DECOMPRESS_ZLIB,
+    HISTOGRAM_COUNT,
+};
+}
+
+// Latencies are counted in power of two buckets of nanoseconds,
+// from 1 us (2^10 ns) to 8.6 s (2^33 ns), and above.
+#define METRICS_FIRST_BUCKET 10
+#define METRICS_BUCKET_COUNT 25
+
+struct SLOBHistogramSnapshot {
+    const char *name;
+    const char *labels;
+    // Observations in each bucket (not cumulative).
+    uint64_t buckets[METRICS_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t sum_ns;
+};
+
+struct SLOBCounterSnapshot {
+    const char *name;
+    const char *labels;
+    uint64_t value;
+};
+
+struct SLOBMetricsSnapshot {
+    std::vector<SLOBCounterSnapshot> counters;
+    std::vector<SLOBHistogramSnapshot> histograms;
+};
+
+// One timed operation, reported to the trace sink.
+struct SLOBSpan {
+    METRIC::HISTOGRAM operation;
+    // Operation name, as in histogram labels.
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds duration;
+};
+
+// Process-wide metrics of every SLOB reader and dictionary. The
+// read path is only instrumented when the library is built with
+// SLOB_METRICS; otherwise every metric stays at zero and no spans
+// are reported. All members can be called concurrently.
+class SLOBMetrics {
+public:
+    // Whether the library was built with metrics.
+    static bool enabled();
+
+    static void add(METRIC::COUNTER, uint64_t value = 1);
+    static void observe(METRIC::HISTOGRAM, std::chrono::steady_clock::time_point start,
+                        std::chrono::nanoseconds);
+
+    static SLOBMetricsSnapshot snapshot();
+    // Snapshot in the Prometheus text exposition format.
+    static std::string prometheus();
+    static void reset();
+
+    // Report every timed operation to the sink, on the thread
+    // that ran it, until the sink is cleared with nullptr.
+    static void set_trace_sink(std::function<void(const SLOBSpan &)>);
+};
+
+// Times its scope into a histogram.
+class SLOBTimer {
+public:
+    SLOBTimer(METRIC::HISTOGRAM histogram)
+        : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+    ~SLOBTimer()
+    {
+        SLOBMetrics::observe(m_histogram, m_start, std::chrono::steady_clock::now() - m_start);
+    }
+
+    SLOBTimer(const SLOBTimer &) = delete;
+    SLOBTimer &operator=(const SLOBTimer &) = delete;
+
+private:
+    METRIC::HISTOGRAM m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Instrumentation points, compiled out without SLOB_METRICS.
+#ifdef SLOB_METRICS
+#define SLOB_TIMER_CONCAT(name, line) name##line
+#define SLOB_TIMER_NAME(line) SLOB_TIMER_CONCAT(slob_timer_, line)
+#define SLOB_COUNT(counter, value) SLOBMetrics::add(METRIC::counter, value)
+#define SLOB_TIME(histogram) SLOBTimer SLOB_TIMER_NAME(__LINE__)(METRIC::histogram)
+#else
+#define SLOB_COUNT(counter, value) ((void)0)
+#define SLOB_TIME(histogram) ((void)0)
+#endif
+
+#endif
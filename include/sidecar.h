@@ -0,0 +1,100 @@
+// Index files stored alongside SLOB files
+#ifndef _SIDECAR_H
+#define _SIDECAR_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include "slob.h"
+
+#define SIDECAR_VERSION 1
+#define SIDECAR_MAGIC_LEN 8
+
+// Every sidecar starts with its magic value, the format version,
+// and the uuid and size of the SLOB file it was built from, so an
+// index is rejected once its dictionary is replaced. Payloads are
+// stored little-endian.
+class SLOBSidecarWriter {
+public:
+    // Writes go to a temporary file, renamed to the
+    // path by commit().
+    SLOBSidecarWriter(const char *path, const char *magic, const SLOBReader &);
+    ~SLOBSidecarWriter();
+
+    void write(std::string_view);
+    void write_byte(U_CHAR);
+    void write_int(U_INT);
+    void write_long(U_LONG_LONG);
+    // Unsigned LEB128 variable length integer.
+    void write_varint(U_LONG_LONG);
+
+    // Bytes written after the header.
+    U_LONG_LONG offset() const { return m_offset; }
+
+    void commit();
+
+private:
+    std::string m_path;
+    std::string m_temp_path;
+    std::ofstream m_out;
+    U_LONG_LONG m_offset { 0 };
+    bool m_committed { false };
+};
+
+class SLOBSidecar {
+public:
+    // Map a sidecar, and check it belongs to the reader's file.
+    void open(const char *path, const char *magic, const SLOBReader &);
+
+    // Payload following the header.
+    std::string_view data() const { return m_data; }
+
+private:
+    SLOBFile m_file;
+    std::string_view m_data;
+};
+
+// Little-endian payload encoding, for payloads
+// assembled in memory.
+inline void append_int(std::string &out, U_INT value)
+{
+    for (int i = 0; i < U_INT_SIZE; i++)
+        out.push_back(value >> (8 * i));
+}
+
+inline void append_varint(std::string &out, U_LONG_LONG value)
+{
+    while (value >= 0x80) {
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+// Little-endian payload decoding.
+inline U_INT load_int(const char *data)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    return (U_INT)p[0] | (U_INT)p[1] << 8 | (U_INT)p[2] << 16 | (U_INT)p[3] << 24;
+}
+
+inline U_LONG_LONG load_long(const char *data)
+{
+    return (U_LONG_LONG)load_int(data) | (U_LONG_LONG)load_int(data + 4) << 32;
+}
+
+inline U_LONG_LONG read_varint(std::string_view data, size_t &pos)
+{
+    U_LONG_LONG value = 0;
+    for (int shift = 0; pos < data.size() && shift < 64; shift += 7) {
+        U_CHAR byte = data[pos++];
+        value |= (U_LONG_LONG)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw std::runtime_error("SLOB: Truncated sidecar varint");
+}
+
+#endif
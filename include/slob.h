@@ -3,14 +3,25 @@
 #define _SLOB_H
 
 #include <map>
+#include <list>
 #include <cmath>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <string>
+#include <span>
 #include <cstdint>
+#include <functional>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string_view>
+#include <unordered_map>
 #include "iteration.h"
+#include "bin_cache.h"
+#include "slob_file.h"
+#include "thread_pool.h"
 #include "compression.h"
 
 #define UTF8 "utf-8"
@@ -35,6 +46,38 @@ typedef unsigned short U_SHORT;
 typedef unsigned long long U_LONG_LONG;
 typedef uint32_t U_INT;
 
+// Number of decoded references kept by lazily loaded readers.
+#define DEFAULT_REFERENCE_CACHE_SIZE 1024
+// Memory budget, in bytes, for decompressed bins cached by
+// SLOBReader::item().
+#define DEFAULT_BIN_CACHE_SIZE (16 << 20)
+// Read-ahead used when decoding every reference at open.
+#define REFERENCES_READ_BUFFER_SIZE (1 << 20)
+
+// Reference table loading strategies for SLOBReader::open_file().
+//
+// EAGER decodes every reference when the file is opened.
+// LAZY only reads the reference positions, and decodes
+// references from the file as they are accessed.
+namespace REFERENCES {
+enum LOADING {
+    EAGER,
+    LAZY,
+};
+}
+
+// Delivery order of parallel iteration.
+namespace DELIVERY {
+enum ORDER {
+    ORDERED,
+    UNORDERED,
+};
+}
+
+// Bins decompressed ahead of parallel iteration
+// callbacks, per pool thread.
+#define DEFAULT_BIN_WINDOW_PER_THREAD 2
+
 #define MIME_TEXT "text/plain"
 #define MIME_HTML "text/html"
 
@@ -50,16 +93,77 @@ struct SLOBReference {
     std::string fragment;
 };
 
+// Reference fields viewed in place. The views stay
+// valid for as long as the reader keeps the file open.
+struct SLOBReferenceView {
+    std::string_view key;
+    U_INT bin_index;
+    U_SHORT item_index;
+    std::string_view fragment;
+};
+
+// Materialize a reference view into an owning reference.
+inline SLOBReference to_reference(const SLOBReferenceView &ref)
+{
+    return { std::string(ref.key), ref.bin_index, ref.item_index, std::string(ref.fragment) };
+}
+
+inline SLOBReferenceView to_view(const SLOBReference &ref)
+{
+    return { ref.key, ref.bin_index, ref.item_index, ref.fragment };
+}
+
+// In-memory reference table stored as parallel arrays. Keys and
+// fragments are packed into one byte arena, so the table needs no
+// allocation per reference, and views point into the arena.
+class SLOBReferenceTable {
+public:
+    void reserve(size_t count, size_t bytes);
+    void push_back(std::string_view key, U_INT bin_index,
+                   U_SHORT item_index, std::string_view fragment);
+    void shrink_to_fit();
+    void clear();
+
+    size_t size() const { return m_offsets.size(); }
+    SLOBReferenceView operator[](size_t) const;
+
+    // Bytes allocated by the table.
+    size_t memory_usage() const;
+
+private:
+    std::string m_arena;
+    std::vector<U_LONG_LONG> m_offsets;
+    std::vector<U_SHORT> m_key_lengths;
+    std::vector<U_CHAR> m_fragment_lengths;
+    std::vector<U_INT> m_bin_indexes;
+    std::vector<U_SHORT> m_item_indexes;
+};
+
 struct SLOBStoreItem {
     std::vector<U_CHAR> content_type_ids;
     std::string content;
 };
 
+// Store item viewed in place, with its content
+// still compressed.
+struct SLOBStoreItemView {
+    std::string_view content_type_ids;
+    std::string_view content;
+};
+
 struct SLOBItem {
     std::string content_type;
     std::string content;
 };
 
+// Item content viewed in its decompressed bin, which the
+// view keeps alive (and shares with the bin cache).
+struct SLOBItemView {
+    std::shared_ptr<const SLOBStoreItem> bin;
+    std::string_view content;
+    std::string_view content_type;
+};
+
 struct SLOBHeader {
     std::string uuid;
     std::string encoding;
@@ -72,36 +176,60 @@ struct SLOBHeader {
     size_t size;
 };
 
+// View of a decompressed bin. Item positions and contents are
+// parsed in place, so the bin's content must outlive the views.
 class SLOBStorageBin {
 public:
+    SLOBStorageBin(std::string_view, U_INT);
     SLOBStorageBin(const SLOBStoreItem &, U_INT);
-    std::string item(U_SHORT);
-    std::string next();
 
-private:
-    template<typename LenSpec>
-    std::string read_byte_string();
-    template<typename LenSpec>
-    std::string _read_text();
+    U_INT size() const { return m_item_count; }
 
-    std::string read_tiny_text();
-    std::string read_text();
-    U_INT read_int();
+    std::string_view item(U_SHORT) const;
+    std::string_view next();
 
-    const SLOBStoreItem &m_store_item;
-    std::istringstream m_stream;
-    std::vector<U_INT> m_item_positions;
+private:
+    U_INT read_int(size_t) const;
+
+    std::string_view m_content;
     size_t m_items_data_offset;
     U_INT m_item_count;
+    U_INT m_next { 0 };
 };
 
+class SLOBReferenceIterator;
+class SLOBStoreItemIterator;
+class SLOBItemIterator;
+class SLOBAsyncReader;
+class SLOBExporter;
+template <typename Iterator, typename Sentinel = Iterator>
+class SLOBRange;
+
+// Once a file is opened, reading members (references, store
+// items, items and iteration) can be called from many threads.
 class SLOBReader {
 public:
     SLOBReader();
     ~SLOBReader();
 
     // Open SLOB file for parsing.
-    void open_file(const char *);
+    void open_file(const char *, REFERENCES::LOADING = REFERENCES::EAGER,
+                   BACKEND::TYPE = BACKEND::STREAM);
+
+    // Set the number of decoded references cached when
+    // references are loaded lazily. 0 disables the cache.
+    void set_reference_cache_size(size_t);
+
+    // Set the memory budget, in bytes, of the decompressed
+    // bin cache used by item(). 0 disables the cache, and
+    // item() then always stops decompressing at the requested
+    // item.
+    void set_bin_cache_size(size_t);
+    SLOBCacheStats bin_cache_stats() const;
+
+    // Hint how a mapped file will be accessed: SEQUENTIAL
+    // before full scans, RANDOM for lookups.
+    void advise(ACCESS::PATTERN) const;
 
     // Print SLOB header info.
     void print_header_info() const;
@@ -110,7 +238,8 @@ public:
     std::string encoding() const { return m_header.encoding; }
     std::string compression() const { return m_header.compression; }
     U_INT blob_count() const { return m_header.blob_count; }
-    U_INT ref_count() const { return m_references.size(); }
+    U_INT ref_count() const { return m_reference_count; }
+    U_INT bin_count() const { return m_store_item_count; }
     size_t size() const { return m_header.size; }
 
     template<typename C>
@@ -120,64 +249,186 @@ public:
     template<typename C>
     void for_each_content_type(C) const;
     // Access SLOB header content types.
-    std::string content_type(U_CHAR) const;
+    const std::string &content_type(U_CHAR) const;
 
-    // Iterate over all SLOB references.
+    // Iterate over all SLOB references. The callback receives
+    // a SLOBReferenceView, only valid during the call.
+    template<typename C>
+    void for_each_reference(C) const;
+    SLOBReference reference(U_INT) const;
+    // View a reference in the in-memory table, or in place in a
+    // mapped file. Lazily loaded, unmapped files have no views.
+    SLOBReferenceView reference_view(U_INT) const;
+    // Call with a view of one reference, valid during the call.
+    // Works for every loading strategy and backend.
     template<typename C>
-    void for_each_reference(C);
-    SLOBReference reference(U_INT);
+    auto visit_reference(U_INT, C) const;
+    // Whether reference_view() is available.
+    bool reference_views() const { return m_loading == REFERENCES::EAGER || m_file.mapped(); }
 
     // Iterate over all SLOB store items.
     template<typename C>
-    void for_each_store_item(C);
-    SLOBStoreItem store_item(U_INT);
+    void for_each_store_item(C) const;
+    SLOBStoreItem store_item(U_INT) const;
+    // Number of items in a bin, read without decompressing it.
+    U_INT bin_item_count(U_INT) const;
+    // View a compressed store item in place (mapped files only).
+    SLOBStoreItemView store_item_view(U_INT) const;
 
     // Iterate over all SLOB items.
     template<typename C>
-    void for_each_item(C);
+    void for_each_item(C) const;
+    // Iterate over all SLOB items, decompressing bins in parallel
+    // on the pool. The callback runs on the calling thread (never
+    // a pool worker), with SLOBItemViews in bin order, or as bins
+    // complete. At most window bins (by default
+    // DEFAULT_BIN_WINDOW_PER_THREAD per pool thread) are held
+    // ahead of the callback, which bounds memory use.
+    template<typename C>
+    void for_each_item(C, SLOBThreadPool &, DELIVERY::ORDER = DELIVERY::ORDERED,
+                       size_t window = 0) const;
+    // Parallel iteration over decompressed bins, as above.
+    // The callback returns true to stop.
+    void for_each_bin(const std::function<bool(U_INT, std::shared_ptr<const SLOBStoreItem>)> &,
+                      SLOBThreadPool &, DELIVERY::ORDER = DELIVERY::ORDERED,
+                      size_t window = 0) const;
 
     // Access specific SLOB items using the bin 
     // index, and item index within the bin.
-    std::string item(U_INT, U_SHORT);
+    //
+    // A compressed bin missing from the bin cache is only
+    // decompressed up to the requested item, and not cached,
+    // unless it missed recently before: one-off lookups stop
+    // early, while bins read again are decompressed whole and
+    // cached for the next items.
+    std::string item(U_INT, U_SHORT) const;
+    // View an item without copying it out of its bin.
+    SLOBItemView item_view(U_INT, U_SHORT) const;
+
+    // Access the items of many references at once, in the
+    // order of the references. Each bin is decompressed once;
+    // with a thread pool, bins are decompressed in parallel.
+    std::vector<std::string> items(std::span<const SLOBReference>,
+                                   SLOBThreadPool * = nullptr) const;
+
+    // Lazy ranges (see slob_ranges.h) over all references, store
+    // items and items, reading each element on dereference.
+    SLOBRange<SLOBReferenceIterator> references() const;
+    SLOBRange<SLOBStoreItemIterator> store_items() const;
+    SLOBRange<SLOBItemIterator> items() const;
 
 private:
+    friend class SLOBAsyncReader;
+    friend class SLOBExporter;
+
     void parse_header();
     void read_store_item_positions();
     void read_reference_positions();
     void read_references();
+    SLOBReference read_reference(U_INT) const;
+    SLOBReference read_reference(SLOBCursor &) const;
+
+    // Decompressed bin, from the bin cache if possible.
+    std::shared_ptr<const SLOBStoreItem> cached_store_item(U_INT) const;
 
-    std::string (*decompress)(const std::string &) { nullptr };
+    U_LONG_LONG reference_position(U_INT) const;
+    U_LONG_LONG store_item_position(U_INT) const;
 
+    // Read a store item's content type IDs into the item, and
+    // return its compressed content: a view of the mapped file,
+    // or read into the buffer.
+    std::string_view read_store_item(U_INT, SLOBStoreItem &, std::string &) const;
+
+    // Offset and length of a store item in the file, up to the next
+    // store item (or the end of the file). The length is 0 when the
+    // next store item does not follow it.
+    std::pair<U_LONG_LONG, size_t> store_item_extent(U_INT) const;
+    // Parse and decompress a store item read whole.
+    SLOBStoreItem decode_store_item(std::string_view) const;
+    // Decompress a store item's content into out.
+    void decompress(std::string_view, std::string &out) const;
+
+    // Decompress a bin only up to the end of one item.
+    std::string partial_item(U_INT, U_SHORT) const;
+
+    // Codec of the file's compression type, or nullptr for
+    // uncompressed files.
+    const SLOBCodec *m_codec { nullptr };
+
+    template<typename LenSpec>
+    std::string read_byte_string(SLOBCursor &) const;
     template<typename LenSpec>
-    std::string read_byte_string();
+    std::string_view view_byte_string(SLOBCursor &) const;
     template<typename LenSpec>
-    std::string _read_text();
+    std::string _read_text(SLOBCursor &) const;
+    template<typename T>
+    T read_number(SLOBCursor &) const;
 
-    std::string read_tiny_text();
-    std::string read_text();
-    U_INT read_int();
-    U_LONG_LONG read_long();
-    U_CHAR read_byte();
-    U_SHORT read_short();
+    std::string read_tiny_text(SLOBCursor &) const;
+    std::string read_text(SLOBCursor &) const;
+    U_INT read_int(SLOBCursor &) const;
+    U_LONG_LONG read_long(SLOBCursor &) const;
+    U_CHAR read_byte(SLOBCursor &) const;
+    U_SHORT read_short(SLOBCursor &) const;
 
     SLOBHeader m_header;
-    std::ifstream m_fp;
-    size_t m_filesize;
+    SLOBFile m_file;
 
-    std::vector<SLOBReference> m_references;
+    REFERENCES::LOADING m_loading { REFERENCES::EAGER };
+    SLOBReferenceTable m_references;
+    U_INT m_reference_count { 0 };
+    // Reference and store item positions are only copied into
+    // memory when the file is not mapped.
     std::vector<U_LONG_LONG> m_reference_positions;
+    size_t m_reference_positions_offset;
     size_t m_reference_data_offset;
 
+    // Least recently used decoded references (lazy loading).
+    mutable std::mutex m_reference_cache_mutex;
+    mutable std::list<std::pair<U_INT, SLOBReference>> m_reference_cache;
+    mutable std::unordered_map<U_INT, decltype(m_reference_cache)::iterator> m_reference_cache_index;
+    // Read without the lock, to skip it when the cache is disabled.
+    std::atomic<size_t> m_reference_cache_size { DEFAULT_REFERENCE_CACHE_SIZE };
+
+    mutable SLOBBinCache m_bin_cache { DEFAULT_BIN_CACHE_SIZE };
+
+    U_INT m_store_item_count { 0 };
     std::vector<U_LONG_LONG> m_store_item_positions;
+    size_t m_store_item_positions_offset;
     size_t m_store_items_data_offset;
 };
 
 template<typename C>
-void SLOBReader::for_each_reference(C call)
+void SLOBReader::for_each_reference(C call) const
 {
-    for (auto &ref : m_references)
-        if (call(ref))
+    if (!reference_views()) {
+        for (U_INT i = 0; i < m_reference_count; i++) {
+            SLOBReference ref = read_reference(i);
+            SLOBReferenceView view = to_view(ref);
+            if (call(view))
+                break;
+        }
+        return;
+    }
+
+    for (U_INT i = 0; i < m_reference_count; i++) {
+        SLOBReferenceView view = reference_view(i);
+        if (call(view))
             break;
+    }
+}
+
+template<typename C>
+auto SLOBReader::visit_reference(U_INT index, C call) const
+{
+    if (!reference_views()) {
+        SLOBReference ref = reference(index);
+        SLOBReferenceView view = to_view(ref);
+        return call(view);
+    }
+
+    SLOBReferenceView view = reference_view(index);
+    return call(view);
 }
 
 template<typename C>
@@ -197,65 +448,28 @@ void SLOBReader::for_each_content_type(C call) const
 }
 
 template<typename C>
-void SLOBReader::for_each_store_item(C call)
+void SLOBReader::for_each_store_item(C call) const
 {
-    m_fp.seekg(m_store_items_data_offset);
-
-    for (U_LONG_LONG &position : m_store_item_positions) {
-        m_fp.seekg(m_store_items_data_offset + position);
-        SLOBStoreItem item;
-
-        U_INT bin_item_count = read_int();
-        char packed_content_type_ids[bin_item_count];
-        m_fp.read(packed_content_type_ids, bin_item_count);
-
-        for (unsigned int i = 0; i < bin_item_count; i++)
-            item.content_type_ids.push_back(packed_content_type_ids[i]);
-
-        U_INT content_length = read_int();
-
-        item.content.resize(content_length);
-        m_fp.read(&item.content[0], content_length);
-
-        if (decompress)
-            item.content = decompress(item.content);
-
+    for (U_INT i = 0; i < m_store_item_count; i++) {
+        SLOBStoreItem item = store_item(i);
         if (call(item))
             break;
     }
 }
 
 template<typename C>
-void SLOBReader::for_each_item(C call)
+void SLOBReader::for_each_item(C call) const
 {
-    m_fp.seekg(m_store_items_data_offset);
-
-    for (U_LONG_LONG &position : m_store_item_positions) {
-        m_fp.seekg(m_store_items_data_offset + position);
-        SLOBStoreItem store_item;
-
-        U_INT bin_item_count = read_int();
-        char packed_content_type_ids[bin_item_count];
-        m_fp.read(packed_content_type_ids, bin_item_count);
-
-        for (unsigned int i = 0; i < bin_item_count; i++)
-            store_item.content_type_ids.push_back(packed_content_type_ids[i]);
-
-        U_INT content_length = read_int();
-
-        store_item.content.resize(content_length);
-        m_fp.read(&store_item.content[0], content_length);
-
-        if (decompress)
-            store_item.content = decompress(store_item.content);
+    for (U_INT bin = 0; bin < m_store_item_count; bin++) {
+        SLOBStoreItem store_item = this->store_item(bin);
+        U_INT bin_item_count = store_item.content_type_ids.size();
 
         SLOBStorageBin storage_bin(store_item, bin_item_count);
 
         for (U_INT i = 0; i < bin_item_count; i++) {
-            const std::string content = storage_bin.next();
             SLOBItem item = {
                 content_type(store_item.content_type_ids[i]),
-                content,
+                std::string(storage_bin.next()),
             };
             if (call(item))
                 return;
@@ -263,4 +477,27 @@ void SLOBReader::for_each_item(C call)
     }
 }
 
+template<typename C>
+void SLOBReader::for_each_item(C call, SLOBThreadPool &pool, DELIVERY::ORDER order,
+                               size_t window) const
+{
+    for_each_bin([&](U_INT, std::shared_ptr<const SLOBStoreItem> store_item) {
+        U_INT bin_item_count = store_item->content_type_ids.size();
+        SLOBStorageBin storage_bin(*store_item, bin_item_count);
+
+        for (U_INT i = 0; i < bin_item_count; i++) {
+            SLOBItemView item = {
+                store_item,
+                storage_bin.next(),
+                content_type(store_item->content_type_ids[i]),
+            };
+            if (call(item))
+                return true;
+        }
+        return false;
+    }, pool, order, window);
+}
+
+#include "slob_ranges.h"
+
 #endif
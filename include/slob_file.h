@@ -0,0 +1,102 @@
+// File access backends for the SLOB reader
+#ifndef _SLOB_FILE_H
+#define _SLOB_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <string_view>
+
+// Bytes read ahead by a SLOBCursor on unmapped files.
+#define READ_BUFFER_SIZE 4096
+
+// File access backends for SLOBReader::open_file().
+//
+// STREAM reads with positional reads (pread), copying
+// every read into memory owned by the reader.
+// MMAP maps the whole file, so reads are served from
+// the page cache and views can point into the file.
+namespace BACKEND {
+enum TYPE {
+    STREAM,
+    MMAP,
+};
+}
+
+// Expected access patterns, passed to madvise() for
+// mapped files.
+namespace ACCESS {
+enum PATTERN {
+    NORMAL,
+    SEQUENTIAL,
+    RANDOM,
+};
+}
+
+// Read-only SLOB file. Neither backend has a shared file
+// position, so an open file can be read from many threads.
+class SLOBFile {
+public:
+    SLOBFile();
+    ~SLOBFile();
+
+    SLOBFile(const SLOBFile &) = delete;
+    SLOBFile &operator=(const SLOBFile &) = delete;
+
+    void open(const char *, BACKEND::TYPE);
+    void close();
+
+    size_t size() const { return m_size; }
+    bool mapped() const { return m_data != nullptr; }
+    // Descriptor of the open file, for asynchronous reads.
+    int fd() const { return m_fd; }
+
+    // Copy length bytes at offset into the buffer.
+    void read(uint64_t offset, char *, size_t) const;
+
+    // View length bytes at offset. Only mapped files
+    // can be viewed; the view lives as long as the file.
+    std::string_view view(uint64_t offset, size_t) const;
+
+    // Hint the expected access pattern of a byte range.
+    // A length of 0 covers everything after offset.
+    void advise(ACCESS::PATTERN, uint64_t offset = 0, size_t length = 0) const;
+
+private:
+    void check_range(uint64_t offset, size_t) const;
+
+    int m_fd { -1 };
+    const char *m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+// Sequential reader over a SLOBFile, starting at an offset.
+// Unmapped files are read ahead into the cursor's own buffer,
+// so every thread can use its own cursors on one file.
+class SLOBCursor {
+public:
+    SLOBCursor(const SLOBFile &, uint64_t offset, size_t buffer_size = READ_BUFFER_SIZE);
+
+    uint64_t offset() const { return m_offset; }
+    void seek(uint64_t offset) { m_offset = offset; }
+    void skip(size_t length) { m_offset += length; }
+
+    // Copy the next length bytes into the buffer.
+    void read(char *, size_t);
+
+    // View the next length bytes. For unmapped files the
+    // view lives until the cursor reads again.
+    std::string_view view(size_t);
+
+private:
+    bool buffered(size_t) const;
+    void fill(size_t);
+
+    const SLOBFile &m_file;
+    uint64_t m_offset;
+
+    std::string m_buffer;
+    uint64_t m_buffer_offset { 0 };
+    size_t m_buffer_size;
+};
+
+#endif
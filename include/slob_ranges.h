@@ -0,0 +1,212 @@
+// Lazy ranges over SLOB file contents
+#ifndef _SLOB_RANGES_H
+#define _SLOB_RANGES_H
+
+#include <memory>
+#include <ranges>
+#include <iterator>
+#include "slob.h"
+
+// Forward iterator over the references of a reader. References are
+// read when dereferenced. Views point into the reader, or for lazily
+// loaded stream readers, into a copy shared by the iterators at the
+// same position.
+class SLOBReferenceIterator {
+public:
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = SLOBReferenceView;
+    using difference_type = std::ptrdiff_t;
+
+    SLOBReferenceIterator() = default;
+    SLOBReferenceIterator(const SLOBReader *reader, U_INT index)
+        : m_reader(reader), m_index(index) {}
+
+    SLOBReferenceView operator*() const
+    {
+        if (m_reader->reference_views())
+            return m_reader->reference_view(m_index);
+        if (!m_buffer)
+            m_buffer = std::make_shared<const SLOBReference>(m_reader->reference(m_index));
+        return to_view(*m_buffer);
+    }
+
+    U_INT index() const { return m_index; }
+
+    SLOBReferenceIterator &operator++()
+    {
+        m_index++;
+        m_buffer.reset();
+        return *this;
+    }
+
+    SLOBReferenceIterator operator++(int)
+    {
+        SLOBReferenceIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const SLOBReferenceIterator &other) const { return m_index == other.m_index; }
+
+private:
+    const SLOBReader *m_reader { nullptr };
+    U_INT m_index { 0 };
+    mutable std::shared_ptr<const SLOBReference> m_buffer;
+};
+
+// Forward iterator over the decompressed store items of a reader.
+// A bin is decompressed when first dereferenced, and shared by the
+// iterators at its position.
+class SLOBStoreItemIterator {
+public:
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = std::shared_ptr<const SLOBStoreItem>;
+    using difference_type = std::ptrdiff_t;
+
+    SLOBStoreItemIterator() = default;
+    SLOBStoreItemIterator(const SLOBReader *reader, U_INT index)
+        : m_reader(reader), m_index(index) {}
+
+    std::shared_ptr<const SLOBStoreItem> operator*() const
+    {
+        if (!m_store_item)
+            m_store_item = std::make_shared<const SLOBStoreItem>(m_reader->store_item(m_index));
+        return m_store_item;
+    }
+
+    U_INT index() const { return m_index; }
+
+    SLOBStoreItemIterator &operator++()
+    {
+        m_index++;
+        m_store_item.reset();
+        return *this;
+    }
+
+    SLOBStoreItemIterator operator++(int)
+    {
+        SLOBStoreItemIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const SLOBStoreItemIterator &other) const { return m_index == other.m_index; }
+
+private:
+    const SLOBReader *m_reader { nullptr };
+    U_INT m_index { 0 };
+    mutable std::shared_ptr<const SLOBStoreItem> m_store_item;
+};
+
+// Forward iterator over every item of a reader, in bin order. Each
+// bin is decompressed once, when an item of it is first dereferenced,
+// and kept alive by the item views. Empty bins are skipped as the
+// iterator reaches them, from their item counts alone, so comparing
+// iterators never decompresses.
+class SLOBItemIterator {
+public:
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = SLOBItemView;
+    using difference_type = std::ptrdiff_t;
+
+    SLOBItemIterator() = default;
+    SLOBItemIterator(const SLOBReader *reader, U_INT bin_index)
+        : m_reader(reader), m_bin_index(bin_index)
+    {
+        settle();
+    }
+
+    SLOBItemView operator*() const
+    {
+        if (!m_store_item)
+            m_store_item = std::make_shared<const SLOBStoreItem>(m_reader->store_item(m_bin_index));
+        SLOBStorageBin storage_bin(*m_store_item, m_store_item->content_type_ids.size());
+        return {
+            m_store_item,
+            storage_bin.item(m_item_index),
+            m_reader->content_type(m_store_item->content_type_ids[m_item_index]),
+        };
+    }
+
+    U_INT bin_index() const { return m_bin_index; }
+    U_SHORT item_index() const { return m_item_index; }
+
+    SLOBItemIterator &operator++()
+    {
+        if (++m_item_index >= m_item_count) {
+            m_bin_index++;
+            m_item_index = 0;
+            m_store_item.reset();
+            settle();
+        }
+        return *this;
+    }
+
+    SLOBItemIterator operator++(int)
+    {
+        SLOBItemIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const SLOBItemIterator &other) const
+    {
+        return m_bin_index == other.m_bin_index && m_item_index == other.m_item_index;
+    }
+
+private:
+    // Move past empty bins, reading only their item counts.
+    void settle()
+    {
+        m_item_count = 0;
+        if (!m_reader)
+            return;
+        for (; m_bin_index < m_reader->bin_count(); m_bin_index++) {
+            m_item_count = m_reader->bin_item_count(m_bin_index);
+            if (m_item_count > 0)
+                return;
+        }
+    }
+
+    const SLOBReader *m_reader { nullptr };
+    U_INT m_bin_index { 0 };
+    U_SHORT m_item_index { 0 };
+    U_INT m_item_count { 0 };
+    mutable std::shared_ptr<const SLOBStoreItem> m_store_item;
+};
+
+template <typename Iterator, typename Sentinel>
+class SLOBRange : public std::ranges::view_interface<SLOBRange<Iterator, Sentinel>> {
+public:
+    SLOBRange() = default;
+    SLOBRange(Iterator begin, Sentinel end)
+        : m_begin(begin), m_end(end) {}
+
+    Iterator begin() const { return m_begin; }
+    Sentinel end() const { return m_end; }
+
+private:
+    Iterator m_begin;
+    Sentinel m_end;
+};
+
+typedef SLOBRange<SLOBReferenceIterator> SLOBReferenceRange;
+typedef SLOBRange<SLOBStoreItemIterator> SLOBStoreItemRange;
+typedef SLOBRange<SLOBItemIterator> SLOBItemRange;
+
+inline SLOBReferenceRange SLOBReader::references() const
+{
+    return { { this, 0 }, { this, m_reference_count } };
+}
+
+inline SLOBStoreItemRange SLOBReader::store_items() const
+{
+    return { { this, 0 }, { this, m_store_item_count } };
+}
+
+inline SLOBItemRange SLOBReader::items() const
+{
+    return { { this, 0 }, { this, m_store_item_count } };
+}
+
+#endif
@@ -0,0 +1,100 @@
+// SLOB (sorted list of blobs) format writer
+#ifndef _SLOB_WRITER_H
+#define _SLOB_WRITER_H
+
+#include <map>
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <string_view>
+#include "slob.h"
+
+// Uncompressed bytes of item content after which a bin is closed.
+#define DEFAULT_BIN_SIZE (512 << 10)
+
+// Builds a SLOB file. Items are packed into bins in the order they
+// are added, and every full bin is compressed (in parallel, on an
+// optional thread pool) and appended to the store in order.
+// References are kept in memory, and sorted by collation order when
+// the file is finalized. The file is written to a temporary path,
+// and renamed once it is complete.
+class SLOBWriter {
+public:
+    // Compression is "lzma2", "zlib", or "" for none.
+    SLOBWriter(const char *path, const std::string &compression = DEFAULT_COMPRESSION,
+               SLOBThreadPool * = nullptr);
+    ~SLOBWriter();
+
+    SLOBWriter(const SLOBWriter &) = delete;
+    SLOBWriter &operator=(const SLOBWriter &) = delete;
+
+    // Close bins once they hold this many items (at most 65535)...
+    void set_bin_item_count(U_INT);
+    // ...or this many bytes of item content.
+    void set_bin_size(size_t);
+
+    // Replace the random uuid (16 bytes), for
+    // reproducible files.
+    void set_uuid(std::string_view);
+
+    void tag(const std::string &name, const std::string &value);
+
+    // Add an item, and return its id for references.
+    U_INT add_item(std::string_view content, const std::string &content_type);
+
+    // Add a key referring to an item added before.
+    void add_reference(std::string_view key, U_INT item, std::string_view fragment = "");
+
+    // Write the header, sorted references and store,
+    // and move the file into place.
+    void finalize();
+
+    U_INT item_count() const { return m_item_bins.size(); }
+    size_t ref_count() const { return m_references.size(); }
+    U_INT bin_count() const { return m_bin_count; }
+
+private:
+    struct Bin {
+        std::vector<U_CHAR> content_type_ids;
+        std::vector<std::string> items;
+        size_t size { 0 };
+    };
+
+    // Compress the open bin in the background, and
+    // write out the bins it has overtaken.
+    void close_bin();
+    void write_bin(std::string_view);
+    // Order of the references by the collation of their keys.
+    std::vector<U_INT> sort_references() const;
+
+    std::string m_path;
+    std::string m_temp_path;
+    std::string m_store_path;
+    std::string m_compression;
+    std::string m_uuid;
+    const SLOBCodec *m_codec { nullptr };
+    SLOBThreadPool *m_pool;
+
+    U_INT m_bin_item_count { (U_INT)MAX_BIN_ITEM_COUNT };
+    size_t m_bin_size { DEFAULT_BIN_SIZE };
+
+    std::vector<std::pair<std::string, std::string>> m_tags;
+    std::vector<std::string> m_content_types;
+    std::map<std::string, U_CHAR> m_content_type_ids;
+
+    std::vector<U_INT> m_item_bins;
+    std::vector<U_SHORT> m_item_indexes;
+    SLOBReferenceTable m_references;
+
+    Bin m_bin;
+    U_INT m_bin_count { 0 };
+    std::deque<std::future<std::string>> m_pending;
+    std::ofstream m_store;
+    std::vector<U_LONG_LONG> m_store_positions;
+    U_LONG_LONG m_store_size { 0 };
+    bool m_finalized { false };
+};
+
+#endif
@@ -0,0 +1,46 @@
+// Substring key search index
+#ifndef _SUBSTRING_INDEX_H
+#define _SUBSTRING_INDEX_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+#include "folding.h"
+
+#define SUBSTRING_INDEX_MAGIC "SLOBSUBS"
+#define SUBSTRING_INDEX_EXTENSION ".substrings"
+
+// Suffix array over the folded key table (see SLOBFoldedKeyTable):
+// the offset of every code point of every folded key, sorted by the
+// rest of its key. Keys containing a term are found by two binary
+// searches for the suffixes starting with it.
+class SLOBSubstringIndex {
+public:
+    static void build(const SLOBReader &, const char *path);
+
+    // Map an index built for the reader's file. Throws if stale,
+    // leaving the index closed.
+    void open(const char *path, const SLOBReader &);
+
+    bool is_open() const { return m_open; }
+
+    // Indexes of the references whose folded key contains the folded
+    // term, in folded key order. Every occurrence of the term is read
+    // to order the keys; only the first limit keys (0 for no limit)
+    // are returned. An empty term matches nothing.
+    std::vector<U_INT> search(std::string_view term, size_t limit = 0) const;
+
+private:
+    // Suffix of a key starting at a byte offset of the key table.
+    std::string_view suffix(U_INT) const;
+
+    SLOBSidecar m_sidecar;
+    bool m_open { false };
+    SLOBFoldedKeyTable m_table;
+    U_INT m_suffix_count { 0 };
+    const char *m_suffixes { nullptr };
+};
+
+#endif
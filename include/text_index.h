@@ -0,0 +1,89 @@
+// Full-text index over item content
+#ifndef _TEXT_INDEX_H
+#define _TEXT_INDEX_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include "slob.h"
+#include "sidecar.h"
+
+#define TEXT_INDEX_MAGIC "SLOBTEXT"
+#define TEXT_INDEX_EXTENSION ".text"
+// Tokens longer than this (in bytes) are not indexed.
+#define TEXT_INDEX_MAX_TOKEN_LEN 64
+// Bins tokenized per build task.
+#define TEXT_INDEX_BINS_PER_TASK 16
+// Bytes of postings a build holds in memory before spilling
+// them to a sorted run file.
+#define TEXT_INDEX_BUILD_MEMORY (256 << 20)
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+// Combination of query terms.
+namespace QUERY {
+enum OPERATOR {
+    AND,
+    OR,
+};
+}
+
+// Item matching a full-text query.
+struct SLOBTextHit {
+    U_INT bin_index;
+    U_SHORT item_index;
+    double score;
+};
+
+// Inverted index of the words in text and HTML items. Words are
+// folded (see fold_key), and each word's postings list the items
+// containing it, as delta-encoded item numbers and word counts.
+// Queries only read the index, never the bins.
+class SLOBTextIndex {
+public:
+    // Tokenize every text item, on the pool if given, and
+    // write the index to path. Postings are spilled to sorted
+    // run files next to path whenever they outgrow memory bytes,
+    // and merged at the end; only the documents (10 bytes each)
+    // and the vocabulary stay in memory.
+    static void build(const SLOBReader &, const char *path, SLOBThreadPool * = nullptr,
+                      size_t memory = TEXT_INDEX_BUILD_MEMORY);
+
+    // Map an index built for the reader's file. Throws if stale,
+    // leaving the index closed.
+    void open(const char *path, const SLOBReader &);
+
+    bool is_open() const { return m_open; }
+    U_INT size() const { return m_document_count; }
+
+    // Up to limit items (0 for no limit) matching all (AND) or
+    // any (OR) of the query's words, best BM25 score first.
+    std::vector<SLOBTextHit> search(std::string_view query, QUERY::OPERATOR = QUERY::AND,
+                                    size_t limit = 10) const;
+
+private:
+    struct Posting {
+        U_INT document;
+        U_INT frequency;
+    };
+
+    // Term number of a folded word, or the term count if absent.
+    U_INT find(std::string_view) const;
+    std::string_view term(U_INT) const;
+    std::vector<Posting> postings(U_INT) const;
+
+    SLOBSidecar m_sidecar;
+    bool m_open { false };
+    U_INT m_document_count { 0 };
+    U_INT m_term_count { 0 };
+    double m_average_length { 0 };
+    const char *m_documents { nullptr };
+    const char *m_term_offsets { nullptr };
+    const char *m_posting_offsets { nullptr };
+    const char *m_document_frequencies { nullptr };
+    std::string_view m_terms;
+    std::string_view m_postings;
+};
+
+#endif
@@ -0,0 +1,76 @@
+// Worker threads for parallel SLOB reading
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+// Fixed set of worker threads. Each worker has its own task
+// queue: tasks submitted from outside the pool are spread over
+// the queues, tasks submitted by a worker go to its own queue,
+// and idle workers steal the oldest tasks of busy ones. Tasks
+// must not block on other tasks of the same pool.
+//
+// Submitting and claiming a task only lock one queue, and count
+// queued tasks atomically; the pool lock is only taken by workers
+// going to sleep, and to wake them when some are asleep.
+class SLOBThreadPool {
+public:
+    SLOBThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~SLOBThreadPool();
+
+    SLOBThreadPool(const SLOBThreadPool &) = delete;
+    SLOBThreadPool &operator=(const SLOBThreadPool &) = delete;
+
+    size_t size() const { return m_workers.size(); }
+
+    void submit(std::function<void()>);
+
+    // Run a task, and get its result (or exception)
+    // through a future.
+    template<typename F>
+    auto async(F) -> std::future<decltype(std::declval<F>()())>;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void work(size_t);
+    // Claim one of the queued tasks, if any.
+    bool claim();
+    // Take the oldest task of the worker's queue,
+    // or steal one from another queue.
+    std::function<void()> take(size_t);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<size_t> m_next_queue { 0 };
+    // Queued tasks not yet claimed by a worker.
+    std::atomic<size_t> m_pending { 0 };
+    // Workers waiting for tasks.
+    std::atomic<size_t> m_sleeping { 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop { false };
+};
+
+template<typename F>
+auto SLOBThreadPool::async(F task) -> std::future<decltype(std::declval<F>()())>
+{
+    using R = decltype(task());
+    auto packaged = std::make_shared<std::packaged_task<R()>>(std::move(task));
+    std::future<R> result = packaged->get_future();
+    submit([packaged]() { (*packaged)(); });
+    return result;
+}
+
+#endif
@@ -0,0 +1,406 @@
+#include "async_reader.h"
+#include "metrics.h"
+#include <stdexcept>
+
+#ifdef SLOB_IO_URING
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <unordered_set>
+#include <liburing.h>
+
+// Largest ring set up per reader; further reads go to the pool.
+#define MAX_ASYNC_RING_ENTRIES 4096
+
+// One bin read, resubmitted until complete after short reads.
+struct RingRead {
+    U_INT bin_index;
+    U_LONG_LONG offset;
+    std::string buffer;
+    size_t done { 0 };
+};
+
+struct SLOBAsyncReader::Ring {
+    Ring(SLOBAsyncReader &reader, unsigned entries) : entries(entries)
+    {
+        int ret = io_uring_queue_init(entries, &ring, 0);
+        if (ret < 0)
+            throw std::runtime_error(std::string("SLOB: io_uring setup failed: ") + strerror(-ret));
+        try {
+            reaper = std::thread([this, &reader]() { reap(reader); });
+        } catch (...) {
+            io_uring_queue_exit(&ring);
+            throw;
+        }
+    }
+
+    ~Ring()
+    {
+        // An empty completion stops the reaper, unless
+        // it stopped when the ring failed.
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failed) {
+                io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+                if (!sqe) {
+                    io_uring_submit(&ring);
+                    sqe = io_uring_get_sqe(&ring);
+                }
+                io_uring_prep_nop(sqe);
+                io_uring_sqe_set_data(sqe, nullptr);
+                io_uring_submit(&ring);
+            }
+        }
+        reaper.join();
+        io_uring_queue_exit(&ring);
+
+        // Reads failed with the ring, whose buffers the
+        // kernel may have used until the ring was gone.
+        for (RingRead *read : reads)
+            delete read;
+    }
+
+    // Submit a new read, taking ownership of it, or the rest of one
+    // in flight (retry). False if the ring is full or has failed.
+    bool submit(int fd, RingRead *read, bool retry = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed || (!retry && in_flight >= entries))
+            return false;
+
+        io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+            if (!sqe)
+                return false;
+        }
+        io_uring_prep_read(sqe, fd, read->buffer.data() + read->done,
+                           read->buffer.size() - read->done, read->offset + read->done);
+        io_uring_sqe_set_data(sqe, read);
+        io_uring_submit(&ring);
+        if (!retry) {
+            reads.insert(read);
+            in_flight++;
+        }
+        return true;
+    }
+
+    // Hand completed reads to the reader, until stopped.
+    void reap(SLOBAsyncReader &reader)
+    {
+        while (true) {
+            io_uring_cqe *cqe;
+            int ret = io_uring_wait_cqe(&ring, &cqe);
+            if (ret == -EINTR)
+                continue;
+            if (ret < 0) {
+                fail(reader, ret);
+                return;
+            }
+
+            RingRead *read = static_cast<RingRead *>(io_uring_cqe_get_data(cqe));
+            int result = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            if (!read)
+                return;
+
+            // The kernel orders a submission before its completion;
+            // taking the submission lock shows that to sanitizers too.
+            std::unique_lock<std::mutex> lock(mutex);
+            // Retry interrupted and short reads. A retry that cannot
+            // be submitted fails the read, like an error would.
+            if (result > 0)
+                read->done += result;
+            bool retry = result == -EINTR || result == -EAGAIN ||
+                         (result > 0 && read->done < read->buffer.size());
+            lock.unlock();
+            if (retry && submit(reader.m_reader.m_file.fd(), read, true))
+                continue;
+
+            lock.lock();
+            reads.erase(read);
+            in_flight--;
+            lock.unlock();
+            std::unique_ptr<RingRead> complete(read);
+            std::exception_ptr error;
+            if (read->done < read->buffer.size())
+                error = std::make_exception_ptr(std::runtime_error("SLOB: Could not read from SLOB file"));
+            reader.decode(read->bin_index, std::move(read->buffer), error);
+        }
+    }
+
+    // The ring can no longer report completions: fail the reads
+    // in flight, and leave further reads to the pool.
+    void fail(SLOBAsyncReader &reader, int ret)
+    {
+        std::vector<U_INT> bins;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+            in_flight = 0;
+            for (RingRead *read : reads)
+                bins.push_back(read->bin_index);
+        }
+        auto error = std::make_exception_ptr(
+            std::runtime_error(std::string("SLOB: io_uring wait failed: ") + strerror(-ret)));
+        for (U_INT bin_index : bins)
+            reader.decode(bin_index, std::string(), error);
+    }
+
+    io_uring ring;
+    unsigned entries;
+    // Guards the submission queue, shared by requesting threads,
+    // and the reads below.
+    std::mutex mutex;
+    unsigned in_flight { 0 };
+    // Reads submitted and not yet completed.
+    std::unordered_set<RingRead *> reads;
+    bool failed { false };
+    std::thread reaper;
+};
+#else
+struct SLOBAsyncReader::Ring {};
+#endif
+
+SLOBAsyncReader::SLOBAsyncReader(const SLOBReader &reader, SLOBThreadPool &pool,
+                                 SLOBExecutor executor, size_t queue_depth)
+    : m_reader(reader), m_pool(pool), m_executor(std::move(executor)), m_queue_depth(queue_depth)
+{
+    if (m_queue_depth == 0)
+        throw std::invalid_argument("SLOB: Queue depth must be positive");
+
+#ifdef SLOB_IO_URING
+    // Mapped files are read from the page cache, not with reads.
+    if (!m_reader.m_file.mapped()) {
+        try {
+            m_ring = std::make_unique<Ring>(*this, std::min<size_t>(m_queue_depth, MAX_ASYNC_RING_ENTRIES));
+        } catch (const std::runtime_error &) {
+            // Without io_uring (e.g. an older kernel), bins are read on the pool.
+        }
+    }
+#endif
+}
+
+SLOBAsyncReader::~SLOBAsyncReader()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]() { return idle(); });
+}
+
+std::vector<U_INT> SLOBAsyncReader::dequeue()
+{
+    std::vector<U_INT> started;
+    while (m_in_flight < m_queue_depth && !m_queue.empty()) {
+        started.push_back(m_queue.front());
+        m_queue.pop_front();
+        m_in_flight++;
+    }
+    return started;
+}
+
+bool SLOBAsyncReader::idle() const
+{
+    return m_in_flight == 0 && m_completing == 0 && m_requests.empty();
+}
+
+void SLOBAsyncReader::set_queue_depth(size_t queue_depth)
+{
+    if (queue_depth == 0)
+        throw std::invalid_argument("SLOB: Queue depth must be positive");
+
+    std::vector<U_INT> started;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue_depth = queue_depth;
+        started = dequeue();
+    }
+    for (U_INT bin_index : started)
+        start(bin_index);
+}
+
+size_t SLOBAsyncReader::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requests.size();
+}
+
+void SLOBAsyncReader::item(U_INT bin_index, U_SHORT item_index, SLOBItemCallback callback)
+{
+    request(bin_index, item_index, std::move(callback), true);
+}
+
+std::future<SLOBItemView> SLOBAsyncReader::item(U_INT bin_index, U_SHORT item_index)
+{
+    auto promise = std::make_shared<std::promise<SLOBItemView>>();
+    std::future<SLOBItemView> result = promise->get_future();
+    request(bin_index, item_index, [promise](SLOBItemView view, std::exception_ptr error) {
+        if (error)
+            promise->set_exception(error);
+        else
+            promise->set_value(std::move(view));
+    }, false);
+    return result;
+}
+
+void SLOBAsyncReader::request(U_INT bin_index, U_SHORT item_index, SLOBItemCallback callback,
+                              bool executor)
+{
+    Request request { item_index, std::move(callback), executor };
+
+    if (bin_index >= m_reader.bin_count()) {
+        auto error = std::make_exception_ptr(
+            std::runtime_error("SLOB: SLOBAsyncReader::item() Bin index out of bounds"));
+        complete(request, nullptr, error);
+        return;
+    }
+
+    if (m_reader.m_bin_cache.budget() > 0) {
+        std::shared_ptr<const SLOBStoreItem> cached = m_reader.m_bin_cache.get(bin_index);
+        if (cached) {
+            complete(request, cached, nullptr);
+            return;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto requests = m_requests.find(bin_index);
+        if (requests != m_requests.end()) {
+            requests->second.push_back(std::move(request));
+            return;
+        }
+
+        m_requests[bin_index].push_back(std::move(request));
+        if (m_in_flight >= m_queue_depth) {
+            m_queue.push_back(bin_index);
+            return;
+        }
+        m_in_flight++;
+    }
+    start(bin_index);
+}
+
+void SLOBAsyncReader::start(U_INT bin_index)
+{
+    if (m_ring && start_ring_read(bin_index))
+        return;
+
+    m_pool.submit([this, bin_index]() {
+        std::shared_ptr<const SLOBStoreItem> store_item;
+        std::exception_ptr error;
+        try {
+            store_item = std::make_shared<const SLOBStoreItem>(m_reader.store_item(bin_index));
+            if (m_reader.m_bin_cache.budget() > 0)
+                m_reader.m_bin_cache.put(bin_index, store_item);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        finish(bin_index, std::move(store_item), error);
+    });
+}
+
+bool SLOBAsyncReader::start_ring_read(U_INT bin_index)
+{
+#ifdef SLOB_IO_URING
+    auto [offset, length] = m_reader.store_item_extent(bin_index);
+    if (length == 0)
+        return false;
+
+    auto read = std::make_unique<RingRead>();
+    read->bin_index = bin_index;
+    read->offset = offset;
+    read->buffer.resize(length);
+    if (!m_ring->submit(m_reader.m_file.fd(), read.get()))
+        return false;
+    read.release();
+
+    SLOB_COUNT(BIN_READS, 1);
+    SLOB_COUNT(FILE_READS, 1);
+    SLOB_COUNT(BYTES_READ, length);
+    return true;
+#else
+    (void)bin_index;
+    return false;
+#endif
+}
+
+void SLOBAsyncReader::decode(U_INT bin_index, std::string record, std::exception_ptr error)
+{
+    m_pool.submit([this, bin_index, record = std::move(record), error]() {
+        std::shared_ptr<const SLOBStoreItem> store_item;
+        std::exception_ptr decode_error = error;
+        if (!decode_error) {
+            try {
+                store_item = std::make_shared<const SLOBStoreItem>(m_reader.decode_store_item(record));
+                if (m_reader.m_bin_cache.budget() > 0)
+                    m_reader.m_bin_cache.put(bin_index, store_item);
+            } catch (...) {
+                decode_error = std::current_exception();
+            }
+        }
+        finish(bin_index, std::move(store_item), decode_error);
+    });
+}
+
+void SLOBAsyncReader::finish(U_INT bin_index, std::shared_ptr<const SLOBStoreItem> store_item,
+                             std::exception_ptr error)
+{
+    std::vector<Request> requests;
+    std::vector<U_INT> started;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_requests.find(bin_index);
+        requests = std::move(found->second);
+        m_requests.erase(found);
+
+        // The slot passes to the next queued bin.
+        m_in_flight--;
+        m_completing++;
+        started = dequeue();
+    }
+    for (U_INT next_bin_index : started)
+        start(next_bin_index);
+
+    for (Request &request : requests)
+        complete(request, store_item, error);
+
+    // Only now may the destructor return, as
+    // completing the requests used this reader.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_completing--;
+    if (idle())
+        m_idle.notify_all();
+}
+
+void SLOBAsyncReader::complete(Request &request, const std::shared_ptr<const SLOBStoreItem> &store_item,
+                               std::exception_ptr error) const
+{
+    SLOBItemView view {};
+    if (!error) {
+        try {
+            SLOBStorageBin storage_bin(*store_item, store_item->content_type_ids.size());
+            view = { store_item, storage_bin.item(request.item_index),
+                     m_reader.content_type(store_item->content_type_ids[request.item_index]) };
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    // Callbacks have no caller to throw to, and must not keep the
+    // bin completing forever, so what they (or the executor) throw
+    // is dropped.
+    try {
+        if (request.executor && m_executor) {
+            m_executor([callback = std::move(request.callback), view, error]() {
+                try {
+                    callback(view, error);
+                } catch (...) {
+                }
+            });
+        } else {
+            request.callback(view, error);
+        }
+    } catch (...) {
+    }
+}
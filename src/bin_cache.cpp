@@ -0,0 +1,117 @@
+#include "bin_cache.h"
+#include "slob.h"
+#include "metrics.h"
+
+// Bytes accounted for a cached bin, including bookkeeping.
+static size_t cached_size(const SLOBStoreItem &item)
+{
+    return sizeof(SLOBStoreItem) + item.content.capacity() +
+        item.content_type_ids.capacity() + 64;
+}
+
+SLOBBinCache::SLOBBinCache(size_t budget)
+    : m_budget(budget)
+{
+}
+
+void SLOBBinCache::set_budget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = budget;
+    evict(m_budget);
+}
+
+size_t SLOBBinCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+std::shared_ptr<const SLOBStoreItem> SLOBBinCache::get(uint32_t bin_index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto cached = m_index.find(bin_index);
+    if (cached == m_index.end()) {
+        m_misses++;
+        SLOB_COUNT(BIN_CACHE_MISSES, 1);
+        return nullptr;
+    }
+
+    m_hits++;
+    SLOB_COUNT(BIN_CACHE_HITS, 1);
+    m_entries.splice(m_entries.begin(), m_entries, cached->second);
+    return cached->second->item;
+}
+
+void SLOBBinCache::put(uint32_t bin_index, std::shared_ptr<const SLOBStoreItem> item)
+{
+    size_t bytes = cached_size(*item);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Another reader may have decompressed the same bin.
+    if (bytes > m_budget || m_index.count(bin_index))
+        return;
+
+    evict(m_budget - bytes);
+
+    m_entries.push_front({ bin_index, std::move(item), bytes });
+    m_index[bin_index] = m_entries.begin();
+    m_bytes += bytes;
+}
+
+bool SLOBBinCache::admit(uint32_t bin_index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_budget == 0)
+        return false;
+    if (m_index.count(bin_index))
+        return true;
+
+    auto missed = m_missed_index.find(bin_index);
+    if (missed != m_missed_index.end()) {
+        m_missed.erase(missed->second);
+        m_missed_index.erase(missed);
+        return true;
+    }
+
+    m_misses++;
+    SLOB_COUNT(BIN_CACHE_MISSES, 1);
+    m_missed.push_front(bin_index);
+    m_missed_index[bin_index] = m_missed.begin();
+    if (m_missed.size() > BIN_CACHE_ADMISSION_HISTORY) {
+        m_missed_index.erase(m_missed.back());
+        m_missed.pop_back();
+    }
+    return false;
+}
+
+void SLOBBinCache::evict(size_t budget)
+{
+    while (m_bytes > budget && !m_entries.empty()) {
+        const Entry &last = m_entries.back();
+        m_bytes -= last.bytes;
+        m_index.erase(last.bin_index);
+        m_entries.pop_back();
+        m_evictions++;
+        SLOB_COUNT(BIN_CACHE_EVICTIONS, 1);
+    }
+}
+
+SLOBCacheStats SLOBBinCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return { m_hits, m_misses, m_evictions, m_entries.size(), m_bytes };
+}
+
+void SLOBBinCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+    m_missed.clear();
+    m_missed_index.clear();
+    m_hits = m_misses = m_evictions = 0;
+}
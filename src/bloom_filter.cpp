@@ -0,0 +1,120 @@
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include "dictionary.h"
+#include "bloom_filter.h"
+
+// Payload: block count, hash count, minimum prefix length, level
+// count, collator version, then the blocks.
+#define BLOOM_FILTER_HEADER_SIZE (4 * U_INT_SIZE + U_MAX_VERSION_LENGTH)
+#define BLOOM_FILTER_BLOCK_SIZE (BLOOM_FILTER_BLOCK_BITS / 8)
+
+static U_LONG_LONG hash_bytes(std::string_view bytes)
+{
+    // FNV-1a, then a 64-bit finalizer to spread the bits.
+    U_LONG_LONG hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Block, and the bits within it, of a hash.
+template<typename C>
+static void for_each_bit(U_LONG_LONG hash, U_INT block_count, U_INT hash_count, C call)
+{
+    U_INT block = ((hash >> 32) * block_count) >> 32;
+    U_INT h1 = hash, h2 = (hash >> 32) | 1;
+    for (U_INT i = 0; i < hash_count; i++)
+        call(block, (h1 + i * h2) % BLOOM_FILTER_BLOCK_BITS);
+}
+
+void SLOBBloomFilter::build(const SLOBReader &reader, const CollationKeyList &key_list, const char *path)
+{
+    std::unordered_set<U_LONG_LONG> hashes;
+    reader.for_each_reference([&](auto &ref) {
+        std::string sortkey = key_list.sort_key(ref.key);
+        size_t length = BLOOM_FILTER_MIN_PREFIX;
+        for (int level = 0; level < BLOOM_FILTER_LEVELS && length <= sortkey.size(); level++, length *= 2)
+            hashes.insert(hash_bytes(std::string_view(sortkey).substr(0, length)));
+        return ITERATION::CONTINUE;
+    });
+
+    size_t bits = std::max<size_t>(hashes.size() * BLOOM_FILTER_BITS_PER_ENTRY, 1);
+    U_INT block_count = (bits + BLOOM_FILTER_BLOCK_BITS - 1) / BLOOM_FILTER_BLOCK_BITS;
+    std::vector<U_CHAR> blocks((size_t)block_count * BLOOM_FILTER_BLOCK_SIZE);
+    for (U_LONG_LONG hash : hashes) {
+        for_each_bit(hash, block_count, BLOOM_FILTER_HASHES, [&](U_INT block, U_INT bit) {
+            blocks[(size_t)block * BLOOM_FILTER_BLOCK_SIZE + bit / 8] |= 1 << (bit % 8);
+        });
+    }
+
+    UVersionInfo version;
+    key_list.collator()->getVersion(version);
+
+    SLOBSidecarWriter writer(path, BLOOM_FILTER_MAGIC, reader);
+    writer.write_int(block_count);
+    writer.write_int(BLOOM_FILTER_HASHES);
+    writer.write_int(BLOOM_FILTER_MIN_PREFIX);
+    writer.write_int(BLOOM_FILTER_LEVELS);
+    writer.write(std::string_view(reinterpret_cast<const char *>(version), U_MAX_VERSION_LENGTH));
+    writer.write(std::string_view(reinterpret_cast<const char *>(blocks.data()), blocks.size()));
+    writer.commit();
+}
+
+void SLOBBloomFilter::open(const char *path, const SLOBReader &reader, const CollationKeyList &key_list)
+{
+    // A failed open leaves the filter closed, passing every
+    // lookup, rather than reading the unmapped blocks.
+    m_open = false;
+    m_block_count = 0;
+    m_blocks = nullptr;
+    m_sidecar.open(path, BLOOM_FILTER_MAGIC, reader);
+    std::string_view data = m_sidecar.data();
+    if (data.size() < BLOOM_FILTER_HEADER_SIZE)
+        throw std::runtime_error("SLOB: Bloom filter is truncated");
+
+    UVersionInfo version;
+    key_list.collator()->getVersion(version);
+    if (std::memcmp(data.data() + 4 * U_INT_SIZE, version, U_MAX_VERSION_LENGTH) != 0)
+        throw std::runtime_error("SLOB: Bloom filter was built with another collator version");
+
+    U_INT block_count = load_int(data.data());
+    U_INT hash_count = load_int(data.data() + U_INT_SIZE);
+    if (block_count == 0 || hash_count == 0
+            || load_int(data.data() + 2 * U_INT_SIZE) != BLOOM_FILTER_MIN_PREFIX
+            || load_int(data.data() + 3 * U_INT_SIZE) != BLOOM_FILTER_LEVELS
+            || data.size() - BLOOM_FILTER_HEADER_SIZE < (size_t)block_count * BLOOM_FILTER_BLOCK_SIZE)
+        throw std::runtime_error("SLOB: Bloom filter is corrupt");
+
+    m_block_count = block_count;
+    m_hash_count = hash_count;
+    m_blocks = data.data() + BLOOM_FILTER_HEADER_SIZE;
+    m_open = true;
+}
+
+bool SLOBBloomFilter::may_contain(std::string_view sortkey) const
+{
+    if (!m_open || sortkey.size() < BLOOM_FILTER_MIN_PREFIX)
+        return true;
+
+    size_t length = BLOOM_FILTER_MIN_PREFIX;
+    for (int level = 1; level < BLOOM_FILTER_LEVELS && length * 2 <= sortkey.size(); level++)
+        length *= 2;
+
+    bool found = true;
+    for_each_bit(hash_bytes(sortkey.substr(0, length)), m_block_count, m_hash_count, [&](U_INT block, U_INT bit) {
+        U_CHAR byte = m_blocks[(size_t)block * BLOOM_FILTER_BLOCK_SIZE + bit / 8];
+        if (!(byte & (1 << (bit % 8))))
+            found = false;
+    });
+    return found;
+}
@@ -0,0 +1,193 @@
+#include <vector>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "dictionary.h"
+#include "collation_index.h"
+
+// Payload: entry count, restart interval, collator version,
+// block count, block offsets and the entries themselves. Each
+// entry is the shared prefix length, suffix length, suffix and
+// reference index, all but the suffix as varints.
+#define COLLATION_INDEX_HEADER_SIZE (3 * U_INT_SIZE + U_MAX_VERSION_LENGTH)
+
+void SLOBCollationIndex::build(const SLOBReader &reader, const CollationKeyList &key_list, const char *path)
+{
+    std::vector<std::string> keys;
+    keys.reserve(reader.ref_count());
+    reader.for_each_reference([&](auto &ref) {
+        keys.push_back(key_list.sort_key(ref.key));
+        return ITERATION::CONTINUE;
+    });
+
+    // References should already be in collation order, but sorting
+    // keeps the index searchable for files that are not.
+    std::vector<U_INT> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](U_INT a, U_INT b) {
+        return keys[a] < keys[b];
+    });
+
+    // Encode the entries first, the block offsets precede them.
+    std::string entries;
+    std::vector<U_LONG_LONG> block_offsets;
+    std::string_view previous;
+    for (size_t i = 0; i < order.size(); i++) {
+        std::string_view key = keys[order[i]];
+        size_t shared = 0;
+        if (i % COLLATION_INDEX_RESTART_INTERVAL == 0) {
+            block_offsets.push_back(entries.size());
+        } else {
+            size_t n = std::min(key.size(), previous.size());
+            while (shared < n && key[shared] == previous[shared])
+                shared++;
+        }
+        append_varint(entries, shared);
+        append_varint(entries, key.size() - shared);
+        entries.append(key.substr(shared));
+        append_varint(entries, order[i]);
+        previous = key;
+    }
+
+    UVersionInfo version;
+    key_list.collator()->getVersion(version);
+
+    SLOBSidecarWriter writer(path, COLLATION_INDEX_MAGIC, reader);
+    writer.write_int(order.size());
+    writer.write_int(COLLATION_INDEX_RESTART_INTERVAL);
+    writer.write(std::string_view(reinterpret_cast<const char *>(version), U_MAX_VERSION_LENGTH));
+    writer.write_int(block_offsets.size());
+    for (U_LONG_LONG offset : block_offsets)
+        writer.write_long(offset);
+    writer.write(entries);
+    writer.commit();
+}
+
+void SLOBCollationIndex::open(const char *path, const SLOBReader &reader, const CollationKeyList &key_list)
+{
+    // A failed open leaves the index closed, so lookups
+    // collate keys instead of reading the unmapped entries.
+    m_open = false;
+    m_count = m_block_count = 0;
+    m_block_offsets = m_entries = std::string_view();
+    m_sidecar.open(path, COLLATION_INDEX_MAGIC, reader);
+    std::string_view data = m_sidecar.data();
+    if (data.size() < COLLATION_INDEX_HEADER_SIZE)
+        throw std::runtime_error("SLOB: Collation index is truncated");
+
+    // Sort keys change between collator versions.
+    UVersionInfo version;
+    key_list.collator()->getVersion(version);
+    if (std::memcmp(data.data() + 2 * U_INT_SIZE, version, U_MAX_VERSION_LENGTH) != 0)
+        throw std::runtime_error("SLOB: Collation index was built with another collator version");
+
+    U_INT count = load_int(data.data());
+    U_INT restart_interval = load_int(data.data() + U_INT_SIZE);
+    U_INT block_count = load_int(data.data() + 2 * U_INT_SIZE + U_MAX_VERSION_LENGTH);
+    size_t offsets_size = (size_t)block_count * U_LONG_LONG_SIZE;
+    if (count != reader.ref_count() || restart_interval == 0
+            || block_count != (count + restart_interval - 1) / restart_interval
+            || data.size() < COLLATION_INDEX_HEADER_SIZE + offsets_size)
+        throw std::runtime_error("SLOB: Collation index is corrupt");
+
+    m_count = count;
+    m_restart_interval = restart_interval;
+    m_block_count = block_count;
+    m_block_offsets = data.substr(COLLATION_INDEX_HEADER_SIZE, offsets_size);
+    m_entries = data.substr(COLLATION_INDEX_HEADER_SIZE + offsets_size);
+    m_open = true;
+}
+
+U_LONG_LONG SLOBCollationIndex::block_offset(U_INT block) const
+{
+    U_LONG_LONG offset = load_long(m_block_offsets.data() + (size_t)block * U_LONG_LONG_SIZE);
+    if (offset >= m_entries.size())
+        throw std::runtime_error("SLOB: Collation index is corrupt");
+    return offset;
+}
+
+std::string_view SLOBCollationIndex::block_key(U_INT block) const
+{
+    // The first key of a block is stored whole, so it
+    // is read straight from the mapping.
+    size_t pos = block_offset(block);
+    read_varint(m_entries, pos);
+    size_t length = read_varint(m_entries, pos);
+    if (length > m_entries.size() - pos)
+        throw std::runtime_error("SLOB: Collation index is corrupt");
+    return m_entries.substr(pos, length);
+}
+
+int SLOBCollationIndex::compare(std::string_view key, std::string_view prefix)
+{
+    size_t n = std::min(key.size(), prefix.size());
+    int cmp = std::memcmp(key.data(), prefix.data(), n);
+    if (cmp == 0 && key.size() < prefix.size())
+        return -1;
+    return cmp;
+}
+
+SLOBCollationIndex::Cursor SLOBCollationIndex::begin() const
+{
+    return Cursor(this, 0);
+}
+
+SLOBCollationIndex::Cursor SLOBCollationIndex::at(U_INT position) const
+{
+    if (position >= m_count)
+        return Cursor(this, m_block_count);
+
+    Cursor cursor(this, position / m_restart_interval);
+    while (cursor.position() < position)
+        cursor.next();
+    return cursor;
+}
+
+SLOBCollationIndex::Cursor SLOBCollationIndex::lower_bound(std::string_view prefix) const
+{
+    // Find the last block starting before the prefix,
+    // then scan forward within it.
+    U_INT low = 0, high = m_block_count;
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        if (compare(block_key(middle), prefix) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    Cursor cursor(this, low > 0 ? low - 1 : 0);
+    while (cursor.valid() && compare(cursor.sort_key(), prefix) < 0)
+        cursor.next();
+    return cursor;
+}
+
+SLOBCollationIndex::Cursor::Cursor(const SLOBCollationIndex *index, U_INT block)
+    : m_index(index), m_position(block * index->m_restart_interval)
+{
+    if (valid()) {
+        m_offset = m_index->block_offset(block);
+        decode();
+    }
+}
+
+void SLOBCollationIndex::Cursor::next()
+{
+    if (++m_position < m_index->m_count)
+        decode();
+}
+
+void SLOBCollationIndex::Cursor::decode()
+{
+    std::string_view entries = m_index->m_entries;
+    size_t shared = read_varint(entries, m_offset);
+    size_t length = read_varint(entries, m_offset);
+    if (shared > m_key.size() || length > entries.size() - m_offset)
+        throw std::runtime_error("SLOB: Collation index is corrupt");
+
+    m_key.resize(shared);
+    m_key.append(entries.substr(m_offset, length));
+    m_offset += length;
+    m_reference = read_varint(entries, m_offset);
+}
@@ -0,0 +1,64 @@
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <unicode/uclean.h>
+#include "collator.h"
+
+static std::unique_ptr<Collator> create_collator(Collator::ECollationStrength strength)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    u_init(&status);
+    if (U_FAILURE(status))
+        throw std::runtime_error("ICU: init failed");
+
+    std::unique_ptr<Collator> collator(Collator::createInstance(Locale(""), status));
+    if (U_FAILURE(status))
+        throw std::runtime_error("ICU: error has occurred");
+    collator->setStrength(strength);
+    collator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_SHIFTED, status);
+    if (U_FAILURE(status))
+        throw std::runtime_error("ICU: error has occurred");
+    return collator;
+}
+
+const Collator &SLOBCollator::prototype(Collator::ECollationStrength strength)
+{
+    static const std::unique_ptr<Collator> primary = create_collator(Collator::PRIMARY);
+    if (strength == Collator::PRIMARY)
+        return *primary;
+
+    static const std::unique_ptr<Collator> identical = create_collator(Collator::IDENTICAL);
+    if (strength == Collator::IDENTICAL)
+        return *identical;
+
+    throw std::invalid_argument("ICU: unsupported collation strength");
+}
+
+const Collator &SLOBCollator::clone(const Collator &collator, std::unique_ptr<Collator> &slot)
+{
+    static std::mutex mutex;
+
+    if (!slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.reset(collator.clone());
+        if (!slot)
+            throw std::runtime_error("ICU: collator clone failed");
+    }
+    return *slot;
+}
+
+const Collator &SLOBCollator::get()
+{
+    thread_local std::unique_ptr<Collator> collator;
+    if (collator)
+        return *collator;
+    return clone(prototype(Collator::PRIMARY), collator);
+}
+
+const Collator &SLOBCollator::sorting()
+{
+    thread_local std::unique_ptr<Collator> collator;
+    if (collator)
+        return *collator;
+    return clone(prototype(Collator::IDENTICAL), collator);
+}
@@ -0,0 +1,136 @@
+#include <queue>
+#include <future>
+#include <filesystem>
+#include "collection.h"
+
+SLOBCollection::SLOBCollection(SLOBThreadPool *pool)
+    : m_pool(pool)
+{
+}
+
+size_t SLOBCollection::open_file(const char *path, REFERENCES::LOADING loading, BACKEND::TYPE backend)
+{
+    Dictionary dictionary;
+    dictionary.reader = std::make_unique<SLOBReader>();
+    dictionary.reader->open_file(path, loading, backend);
+    dictionary.dict = std::make_unique<SLOBDict>(*dictionary.reader);
+
+    std::string index_path = std::string(path) + COLLATION_INDEX_EXTENSION;
+    if (std::filesystem::exists(index_path))
+        dictionary.dict->open_index(index_path.c_str());
+    std::string filter_path = std::string(path) + BLOOM_FILTER_EXTENSION;
+    if (std::filesystem::exists(filter_path))
+        dictionary.dict->open_filter(filter_path.c_str());
+
+    m_dictionaries.push_back(std::move(dictionary));
+    return m_dictionaries.size() - 1;
+}
+
+std::vector<SLOBCollection::Result> SLOBCollection::search(const std::string &term, size_t limit,
+                                                           const std::vector<U_INT> &cursor)
+{
+    std::vector<Result> results(m_dictionaries.size());
+
+    auto search_dictionary = [&](size_t index) {
+        Result &result = results[index];
+        U_INT start = index < cursor.size() ? cursor[index] : 0;
+        result.next = start;
+        result.more = false;
+
+        auto range = m_dictionaries[index].dict->lookup(term, start);
+        for (auto it = range.begin(); it != range.end(); ++it) {
+            if (limit > 0 && result.candidates.size() == limit) {
+                result.next = it.position();
+                result.more = true;
+                break;
+            }
+            result.candidates.push_back({ it.sort_key(), it.position(), to_reference(*it) });
+            result.next = it.position() + 1;
+        }
+    };
+
+    if (!m_pool) {
+        for (size_t i = 0; i < m_dictionaries.size(); i++)
+            search_dictionary(i);
+        return results;
+    }
+
+    std::vector<std::future<void>> pending;
+    for (size_t i = 0; i < m_dictionaries.size(); i++)
+        pending.push_back(m_pool->async([&search_dictionary, i]() { search_dictionary(i); }));
+
+    // Wait for every dictionary before rethrowing the
+    // first error, as the tasks write into results.
+    for (std::future<void> &dictionary : pending)
+        dictionary.wait();
+    for (std::future<void> &dictionary : pending)
+        dictionary.get();
+
+    return results;
+}
+
+std::vector<SLOBCollectionMatch> SLOBCollection::merge(const std::vector<Result> &results, size_t limit,
+                                                       std::vector<size_t> &taken) const
+{
+    // Heap of the next candidate of every dictionary.
+    auto after = [&](size_t a, size_t b) {
+        const Candidate &x = results[a].candidates[taken[a]];
+        const Candidate &y = results[b].candidates[taken[b]];
+        if (x.sort_key != y.sort_key)
+            return x.sort_key > y.sort_key;
+        return a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heads(after);
+
+    taken.assign(results.size(), 0);
+    for (size_t i = 0; i < results.size(); i++)
+        if (!results[i].candidates.empty())
+            heads.push(i);
+
+    std::vector<SLOBCollectionMatch> matches;
+    while (!heads.empty() && (limit == 0 || matches.size() < limit)) {
+        size_t index = heads.top();
+        heads.pop();
+
+        const Candidate &candidate = results[index].candidates[taken[index]++];
+        matches.push_back({ index, m_dictionaries[index].reader->uuid(), candidate.reference });
+
+        if (taken[index] < results[index].candidates.size())
+            heads.push(index);
+    }
+    return matches;
+}
+
+std::vector<SLOBCollectionMatch> SLOBCollection::operator[](const std::string &term)
+{
+    std::vector<size_t> taken;
+    return merge(search(term, 0, {}), 0, taken);
+}
+
+SLOBCollectionPage SLOBCollection::prefix_search(const std::string &prefix, size_t limit,
+                                                 const std::vector<U_INT> &cursor)
+{
+    // No dictionary contributes more than limit matches
+    // to the page.
+    std::vector<Result> results = search(prefix, limit, cursor);
+
+    SLOBCollectionPage page;
+    std::vector<size_t> taken;
+    page.matches = merge(results, limit, taken);
+    page.complete = true;
+
+    // Continue every dictionary after the matches it
+    // contributed to the page.
+    page.next.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        if (taken[i] < results[i].candidates.size()) {
+            page.next[i] = results[i].candidates[taken[i]].position;
+            page.complete = false;
+        } else {
+            page.next[i] = results[i].next;
+            if (results[i].more)
+                page.complete = false;
+        }
+    }
+    return page;
+}
@@ -1,125 +1,235 @@
 #include "compression.h"
+#include "metrics.h"
 #include <zlib.h>
 #include <lzma.h>
 #include <cstring>
 #include <sstream>
-#include <iostream>
+#include <algorithm>
 #include <stdexcept>
 
-const std::map<std::string, std::string (*)(const std::string &)> COMPRESSION = {
+// Smallest output buffer decoded into.
+#define MIN_OUTPUT_SIZE BUFSIZ
+
+// Initial decompressed to compressed size ratio estimate.
+#define DEFAULT_RATIO 4.0
+
+// LZMA2 dictionary size, which decoders must match.
+#define LZMA2_DICT_SIZE (8U << 20)
+#define LZMA2_PRESET 6
+
+// Per thread decoder state, with the last observed compression
+// ratio used to pre-size the next output.
+struct LZMAState {
+    LZMAState() {}
+    ~LZMAState() { lzma_end(&strm); }
+
+    lzma_stream strm = LZMA_STREAM_INIT;
+    double ratio { DEFAULT_RATIO };
+};
+
+struct ZLIBState {
+    ZLIBState()
     {
-        // LZMA2 decompression function
-        "lzma2",
-        [](const std::string &in) -> std::string {
-            lzma_stream strm = LZMA_STREAM_INIT;
-  
-            lzma_options_lzma opt_lzma2 {
-                .dict_size = 8U << 20
-            };
-  
-            lzma_filter filters[] = {
-                { LZMA_FILTER_LZMA2, &opt_lzma2 },
-                { LZMA_VLI_UNKNOWN, NULL },
-            };
-  
-            lzma_ret ret = lzma_raw_decoder(&strm, filters);
-            if (ret != LZMA_OK)
-                throw std::runtime_error("LZMA: lzma_raw_decoder failed");
-  
-            lzma_action action = LZMA_RUN;
-  
-            uint8_t out_buffer[BUFSIZ];
-            std::string out_string;
-  
-            strm.next_in = (unsigned char*)in.data();
-            strm.avail_in = in.size();
-            strm.next_out = out_buffer;
-            strm.avail_out = BUFSIZ;
-  
-            while (true) {
-                strm.next_out = out_buffer;
-                strm.avail_out = BUFSIZ;
-                ret = lzma_code(&strm, action);
-  
-                if (strm.avail_out == 0 || ret == LZMA_STREAM_END) {
-                    strm.next_out = out_buffer;
-                    strm.avail_out = BUFSIZ;
-                }
-  
-                if (ret != LZMA_OK) {
-                    if (ret == LZMA_STREAM_END)
-                        break;
-                    const std::string errmsg = [&ret]() {
-                        switch(ret) {
-                        case LZMA_MEM_ERROR:
-                            return "LZMA: Memory allocation failed";
-                            break;
-                        case LZMA_FORMAT_ERROR:
-                            return "LZMA: Input is not in the .xz format";
-                            break;
-                        case LZMA_OPTIONS_ERROR:
-                            return "LZMA: Unsupported compression options";
-                            break;
-                        case LZMA_DATA_ERROR:
-                            return "LZMA: Compressed data is corrupt";
-                            break;
-                        case LZMA_BUF_ERROR:
-                            return "LZMA: Compressed data is truncated or corrupt";
-                            break;
-                        default:
-                            return "LZMA: Unknown error";
-                            break;
-                        }
-                    }();
-                    std::cout << errmsg << '\n';
-                    throw std::runtime_error("LZMA: Error during LZMA2 decompression");
-                }
-  
-                if (out_string.size() < strm.total_out)
-                    out_string.append(reinterpret_cast<char *>(out_buffer), strm.total_out - out_string.size());
-                else
-                    action = LZMA_FINISH;
+        memset(&strm, 0, sizeof(strm));
+        if (inflateInit(&strm) != Z_OK)
+            throw std::runtime_error("ZLIB: zLib inflateInit() failed");
+    }
+    ~ZLIBState() { inflateEnd(&strm); }
+
+    z_stream strm;
+    double ratio { DEFAULT_RATIO };
+};
+
+// Size the output for decoding, and return how many bytes
+// the next decoder call may produce.
+static size_t prepare_output(std::string &out, size_t produced, size_t needed)
+{
+    if (produced == out.size())
+        out.resize(std::max<size_t>(out.size() * 2, MIN_OUTPUT_SIZE));
+
+    size_t available = out.size() - produced;
+    if (needed != std::string::npos)
+        available = std::min(available, needed - produced);
+    return available;
+}
+
+static void presize_output(std::string &out, size_t in_size, double ratio)
+{
+    size_t estimate = (size_t)(in_size * ratio) + MIN_OUTPUT_SIZE;
+    if (out.capacity() < estimate)
+        out.reserve(estimate);
+    out.resize(out.capacity());
+}
+
+static const char *lzma_error(lzma_ret ret)
+{
+    switch(ret) {
+    case LZMA_MEM_ERROR:
+        return "LZMA: Memory allocation failed";
+    case LZMA_FORMAT_ERROR:
+        return "LZMA: Input is not in the .xz format";
+    case LZMA_OPTIONS_ERROR:
+        return "LZMA: Unsupported compression options";
+    case LZMA_DATA_ERROR:
+        return "LZMA: Compressed data is corrupt";
+    case LZMA_BUF_ERROR:
+        return "LZMA: Compressed data is truncated or corrupt";
+    default:
+        return "LZMA: Unknown error";
+    }
+}
+
+class LZMA2Codec : public SLOBCodec {
+public:
+    const char *name() const override { return "lzma2"; }
+
+    void decompress(std::string_view in, std::string &out,
+                    const decompress_limit *limit) const override
+    {
+        SLOB_TIME(DECOMPRESS_LZMA2);
+        thread_local LZMAState state;
+        lzma_stream &strm = state.strm;
+
+        lzma_options_lzma opt_lzma2 {
+            .dict_size = LZMA2_DICT_SIZE
+        };
+
+        lzma_filter filters[] = {
+            { LZMA_FILTER_LZMA2, &opt_lzma2 },
+            { LZMA_VLI_UNKNOWN, NULL },
+        };
+
+        // Re-initializing an existing stream reuses its allocations.
+        lzma_ret ret = lzma_raw_decoder(&strm, filters);
+        if (ret != LZMA_OK)
+            throw std::runtime_error("LZMA: lzma_raw_decoder failed");
+
+        presize_output(out, in.size(), state.ratio);
+
+        strm.next_in = reinterpret_cast<const uint8_t *>(in.data());
+        strm.avail_in = in.size();
+
+        size_t produced = 0;
+        size_t needed = limit ? (*limit)(std::string_view()) : std::string::npos;
+
+        while (produced < needed) {
+            size_t available = prepare_output(out, produced, needed);
+            strm.next_out = reinterpret_cast<uint8_t *>(&out[produced]);
+            strm.avail_out = available;
+
+            ret = lzma_code(&strm, LZMA_RUN);
+            produced += available - strm.avail_out;
+
+            if (ret == LZMA_STREAM_END)
+                break;
+            if (ret != LZMA_OK) {
+                out.resize(produced);
+                throw std::runtime_error(lzma_error(ret));
             }
-  
-            lzma_end(&strm);
-            return out_string;
-        },
-    },
+
+            if (limit)
+                needed = (*limit)(std::string_view(out.data(), produced));
+        }
+
+        out.resize(produced);
+        SLOB_COUNT(COMPRESSED_BYTES_LZMA2, in.size() - strm.avail_in);
+        SLOB_COUNT(DECOMPRESSED_BYTES_LZMA2, produced);
+        if (!limit && !in.empty())
+            state.ratio = (double)produced / in.size();
+    }
+
+    void compress(std::string_view in, std::string &out) const override
     {
-        // ZLIB decompression function
-        "zlib",
-        [](const std::string &in) -> std::string {
-            z_stream inf_stream;
-            memset(&inf_stream, 0, sizeof(inf_stream));
-  
-            if (inflateInit(&inf_stream) != Z_OK)
-                throw std::runtime_error("ZLIB: zLib inflateInit() failed");
-  
-            inf_stream.next_in = (Bytef*)in.data();
-            inf_stream.avail_in = in.size();
-  
-            int ret;
-            char out_buffer[BUFSIZ];
-            std::string out_string;
-  
-            do {
-                inf_stream.next_out = reinterpret_cast<Bytef*>(out_buffer);
-                inf_stream.avail_out = BUFSIZ;
-                ret = inflate(&inf_stream, Z_NO_FLUSH);
-                if (out_string.size() < inf_stream.total_out) {
-                    out_string.append(out_buffer, inf_stream.total_out - out_string.size());
-                }
-            } while (ret == Z_OK);
-  
-            inflateEnd(&inf_stream);
-  
-            if (ret != Z_STREAM_END) {
+        lzma_options_lzma opt_lzma2;
+        if (lzma_lzma_preset(&opt_lzma2, LZMA2_PRESET))
+            throw std::runtime_error("LZMA: Unsupported preset");
+        opt_lzma2.dict_size = LZMA2_DICT_SIZE;
+
+        lzma_filter filters[] = {
+            { LZMA_FILTER_LZMA2, &opt_lzma2 },
+            { LZMA_VLI_UNKNOWN, NULL },
+        };
+
+        out.resize(lzma_stream_buffer_bound(in.size()));
+        size_t produced = 0;
+        lzma_ret ret = lzma_raw_buffer_encode(filters, NULL,
+                                              reinterpret_cast<const uint8_t *>(in.data()), in.size(),
+                                              reinterpret_cast<uint8_t *>(out.data()), &produced, out.size());
+        if (ret != LZMA_OK)
+            throw std::runtime_error("LZMA: Error during LZMA2 compression");
+        out.resize(produced);
+    }
+};
+
+class ZLIBCodec : public SLOBCodec {
+public:
+    const char *name() const override { return "zlib"; }
+
+    void decompress(std::string_view in, std::string &out,
+                    const decompress_limit *limit) const override
+    {
+        SLOB_TIME(DECOMPRESS_ZLIB);
+        thread_local ZLIBState state;
+        z_stream &inf_stream = state.strm;
+
+        if (inflateReset(&inf_stream) != Z_OK)
+            throw std::runtime_error("ZLIB: zLib inflateReset() failed");
+
+        presize_output(out, in.size(), state.ratio);
+
+        inf_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        inf_stream.avail_in = in.size();
+
+        int ret = Z_OK;
+        size_t produced = 0;
+        size_t needed = limit ? (*limit)(std::string_view()) : std::string::npos;
+
+        while (produced < needed) {
+            size_t available = prepare_output(out, produced, needed);
+            inf_stream.next_out = reinterpret_cast<Bytef *>(&out[produced]);
+            inf_stream.avail_out = available;
+
+            ret = inflate(&inf_stream, Z_NO_FLUSH);
+            produced += available - inf_stream.avail_out;
+
+            if (ret == Z_STREAM_END)
+                break;
+            if (ret != Z_OK) {
+                out.resize(produced);
                 std::ostringstream oss;
-                oss << "ZLIB: Exception occurred during zLib inflation: " << inf_stream.msg;
+                oss << "ZLIB: Exception occurred during zLib inflation: " <<
+                    (inf_stream.msg ? inf_stream.msg : "truncated input");
                 throw std::runtime_error(oss.str());
             }
-  
-            return out_string;
+
+            if (limit)
+                needed = (*limit)(std::string_view(out.data(), produced));
         }
+
+        out.resize(produced);
+        SLOB_COUNT(COMPRESSED_BYTES_ZLIB, in.size() - inf_stream.avail_in);
+        SLOB_COUNT(DECOMPRESSED_BYTES_ZLIB, produced);
+        if (!limit && !in.empty())
+            state.ratio = (double)produced / in.size();
     }
+
+    void compress(std::string_view in, std::string &out) const override
+    {
+        uLongf produced = compressBound(in.size());
+        out.resize(produced);
+        int ret = compress2(reinterpret_cast<Bytef *>(out.data()), &produced,
+                            reinterpret_cast<const Bytef *>(in.data()), in.size(),
+                            Z_DEFAULT_COMPRESSION);
+        if (ret != Z_OK)
+            throw std::runtime_error("ZLIB: Exception occurred during zLib compression");
+        out.resize(produced);
+    }
+};
+
+static const LZMA2Codec lzma2_codec;
+static const ZLIBCodec zlib_codec;
+
+const std::map<std::string, const SLOBCodec *> COMPRESSION = {
+    { "lzma2", &lzma2_codec },
+    { "zlib", &zlib_codec },
 };
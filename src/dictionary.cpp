@@ -6,37 +6,59 @@
 #include <algorithm>
 #include "iteration.h"
 #include "dictionary.h"
+#include "metrics.h"
 
 CollationKeyList::CollationKeyList(SLOBReader &sr)
     : m_slob_reader(sr)
 {
-    UErrorCode status = U_ZERO_ERROR;
-    u_init(&status);
-    if (U_FAILURE(status))
-        throw std::runtime_error("ICU: init failed");
-    m_collator = Collator::createInstance(Locale(""), status);
-    if (U_FAILURE(status))
-        throw std::runtime_error("ICU: error has occurred");
-    m_collator->setStrength(Collator::PRIMARY);
-    m_collator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_SHIFTED, status);
-    if (U_FAILURE(status))
-        throw std::runtime_error("ICU: error has occurred");
 }
 
-CollationKeyList::~CollationKeyList()
+const Collator *CollationKeyList::collator() const
 {
-    delete m_collator;
-    u_cleanup();
+    return &SLOBCollator::get();
 }
 
-Collator *CollationKeyList::collator() const
+void CollationKeyList::set_maxlength(int32_t len)
 {
-    return m_collator;
+    m_maxlength = len;
 }
 
-void CollationKeyList::set_maxlength(int32_t len)
+int32_t CollationKeyList::sort_key(std::string_view key, uint8_t *sortkey) const
 {
-    m_maxlength = len;
+    UnicodeString u_string = UnicodeString::fromUTF8(StringPiece(key.data(), key.size()));
+    return SLOBCollator::get().getSortKey(u_string, sortkey, m_maxlength);
+}
+
+std::string CollationKeyList::sort_key(std::string_view key) const
+{
+    UnicodeString u_string = UnicodeString::fromUTF8(StringPiece(key.data(), key.size()));
+    const Collator &collator = SLOBCollator::get();
+    std::string sortkey(collator.getSortKey(u_string, nullptr, 0), '\0');
+    collator.getSortKey(u_string, reinterpret_cast<uint8_t *>(sortkey.data()), sortkey.size());
+    if (!sortkey.empty())
+        sortkey.pop_back();
+    return sortkey;
+}
+
+int CollationKeyList::compare(std::string_view key, const uint8_t *other, int32_t length) const
+{
+    if (length <= 0)
+        return 0;
+
+    SLOB_COUNT(KEY_COMPARISONS, 1);
+    // ICU truncates the sort key to the buffer length, so only
+    // the compared prefix has to be generated.
+    uint8_t sortkey[length];
+    UnicodeString u_string = UnicodeString::fromUTF8(StringPiece(key.data(), key.size()));
+    int32_t full_length = SLOBCollator::get().getSortKey(u_string, sortkey, length);
+
+    // A shorter sort key ends with its zero terminator, which
+    // always collates before the other key's remaining bytes.
+    int32_t n = std::min(full_length, length);
+    int cmp = std::memcmp(sortkey, other, n);
+    if (cmp == 0 && n < length)
+        return -1;
+    return cmp;
 }
 
 SLOBDict::SLOBDict(SLOBReader &sr)
@@ -44,35 +66,174 @@ SLOBDict::SLOBDict(SLOBReader &sr)
 {
 }
 
-static bool uint8cmp(uint8_t *a, uint8_t *b, size_t n)
+U_INT SLOBDict::lower_bound(const uint8_t *sortkey, int32_t length) const
 {
-    for (size_t i = 0; i < n; i++)
-        if (a[i] != b[i])
-            return false;
-    return true;
+    U_INT low = 0, high = m_slob_reader.ref_count();
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        bool before = m_slob_reader.visit_reference(middle, [&](const SLOBReferenceView &ref) {
+            return m_key_list.compare(ref.key, sortkey, length) < 0;
+        });
+        if (before)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
 }
 
-std::vector<SLOBReference> SLOBDict::operator[](const std::string &term)
+void SLOBDict::open_index(const char *path)
+{
+    m_index.open(path, m_slob_reader, m_key_list);
+}
+
+void SLOBDict::open_filter(const char *path)
 {
-    Collator *m_collator = m_key_list.collator();
+    m_filter.open(path, m_slob_reader, m_key_list);
+}
 
-    UChar u_content[term.length()+1];
-    u_charsToUChars(term.c_str(), u_content, term.length()+1);
-    UnicodeString u_string(u_content);
+void SLOBDict::open_fuzzy_index(const char *path)
+{
+    m_fuzzy_index.open(path, m_slob_reader);
+}
+
+std::vector<SLOBFuzzyMatch> SLOBDict::fuzzy_search(const std::string &term, U_INT max_distance,
+                                                   size_t limit) const
+{
+    std::vector<SLOBFuzzyMatch> matches;
+    for (const SLOBFuzzyHit &hit : m_fuzzy_index.search(term, max_distance, limit))
+        matches.push_back({ m_slob_reader.reference(hit.reference), hit.distance });
+    return matches;
+}
 
-    auto maxlength = m_collator->getSortKey(u_string, nullptr, 0);
-    uint8_t *sortkey = new uint8_t[maxlength];
-    m_collator->getSortKey(u_string, sortkey, maxlength-1);
+void SLOBDict::open_substring_index(const char *path)
+{
+    m_substring_index.open(path, m_slob_reader);
+}
 
+std::vector<SLOBReference> SLOBDict::substring_search(const std::string &term, size_t limit) const
+{
     std::vector<SLOBReference> matches;
+    for (U_INT index : m_substring_index.search(term, limit))
+        matches.push_back(m_slob_reader.reference(index));
+    return matches;
+}
 
-    m_key_list.set_maxlength(maxlength);
-    m_key_list.for_each_key([&](auto &other_key, auto &ref) {
-        if (uint8cmp(sortkey, other_key, maxlength-1))
-            matches.push_back(ref);
-        return ITERATION::CONTINUE;
-    });
+SLOBMatchIterator::SLOBMatchIterator(const SLOBDict *dict, std::shared_ptr<const std::string> sortkey, U_INT start)
+    : m_dict(dict), m_sortkey(sortkey), m_done(false)
+{
+    // References are sorted by collation order, so every key whose
+    // sort key starts with the term's (unterminated) sort key lies
+    // in one contiguous run beginning at the lower bound.
+    if (m_dict->m_index.is_open()) {
+        m_cursor = m_dict->m_index.lower_bound(*m_sortkey);
+        if (m_cursor->position() < start)
+            m_cursor = m_dict->m_index.at(start);
+        m_position = m_cursor->position();
+    } else {
+        const uint8_t *prefix = reinterpret_cast<const uint8_t *>(m_sortkey->data());
+        m_position = std::max(m_dict->lower_bound(prefix, m_sortkey->size()), start);
+    }
+    match();
+}
+
+void SLOBMatchIterator::match()
+{
+    const SLOBReader &reader = m_dict->m_slob_reader;
+
+    U_INT index = m_position;
+    if (m_cursor) {
+        if (!m_cursor->valid() || SLOBCollationIndex::compare(m_cursor->sort_key(), *m_sortkey) != 0) {
+            m_done = true;
+            return;
+        }
+        index = m_cursor->reference();
+    } else if (index >= reader.ref_count()) {
+        m_done = true;
+        return;
+    }
+
+    if (reader.reference_views()) {
+        m_view = reader.reference_view(index);
+    } else {
+        m_buffer = std::make_shared<const SLOBReference>(reader.reference(index));
+        m_view = to_view(*m_buffer);
+    }
+
+    if (!m_cursor) {
+        const uint8_t *prefix = reinterpret_cast<const uint8_t *>(m_sortkey->data());
+        if (m_dict->m_key_list.compare(m_view.key, prefix, m_sortkey->size()) != 0)
+            m_done = true;
+    }
+}
+
+std::string SLOBMatchIterator::sort_key() const
+{
+    if (m_cursor)
+        return std::string(m_cursor->sort_key());
+    return m_dict->m_key_list.sort_key(m_view.key);
+}
+
+SLOBMatchIterator &SLOBMatchIterator::operator++()
+{
+    if (m_cursor) {
+        m_cursor->next();
+        m_position = m_cursor->position();
+    } else {
+        m_position++;
+    }
+    match();
+    return *this;
+}
 
-    delete[] sortkey;
+SLOBMatchIterator SLOBMatchIterator::operator++(int)
+{
+    SLOBMatchIterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+SLOBMatchRange SLOBDict::lookup(const std::string &term, U_INT start) const
+{
+    SLOB_COUNT(LOOKUPS, 1);
+    std::shared_ptr<const std::string> sortkey;
+    {
+        SLOB_TIME(SORT_KEY);
+        sortkey = std::make_shared<const std::string>(m_key_list.sort_key(term));
+    }
+    if (!m_filter.may_contain(*sortkey)) {
+        SLOB_COUNT(LOOKUPS_FILTERED, 1);
+        return { SLOBMatchIterator(), std::default_sentinel };
+    }
+    return { SLOBMatchIterator(this, sortkey, start), std::default_sentinel };
+}
+
+std::vector<SLOBReference> SLOBDict::operator[](const std::string &term)
+{
+    SLOB_TIME(LOOKUP);
+    std::vector<SLOBReference> matches;
+    for (const SLOBReferenceView &ref : lookup(term))
+        matches.push_back(to_reference(ref));
+    SLOB_COUNT(LOOKUP_MATCHES, matches.size());
     return matches;
 }
+
+SLOBSearchPage SLOBDict::prefix_search(const std::string &prefix, size_t limit, U_INT cursor)
+{
+    SLOBSearchPage page { {}, cursor, true };
+    page.references.reserve(std::min<size_t>(limit, 64));
+
+    // Reach one match past the limit to tell
+    // whether another page follows.
+    auto range = lookup(prefix, cursor);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        page.next = it.position();
+        if (page.references.size() == limit) {
+            page.complete = false;
+            break;
+        }
+        page.references.push_back(to_reference(*it));
+        page.next = it.position() + 1;
+    }
+    return page;
+}
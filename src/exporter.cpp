@@ -0,0 +1,319 @@
+#include "exporter.h"
+#include "dictionary.h"
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <unicode/utf8.h>
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static bool valid_utf8(std::string_view text)
+{
+    int32_t length = text.size();
+    if ((size_t)length != text.size())
+        return false;
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(text.data());
+    for (int32_t i = 0; i < length;) {
+        UChar32 c;
+        U8_NEXT(data, i, length, c);
+        if (c < 0)
+            return false;
+    }
+    return true;
+}
+
+static void append_base64(std::string &out, std::string_view data)
+{
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        uint32_t n = (U_CHAR)data[i] << 16 | (U_CHAR)data[i + 1] << 8 | (U_CHAR)data[i + 2];
+        out += BASE64[n >> 18];
+        out += BASE64[(n >> 12) & 63];
+        out += BASE64[(n >> 6) & 63];
+        out += BASE64[n & 63];
+    }
+    if (i + 1 == data.size()) {
+        uint32_t n = (U_CHAR)data[i] << 16;
+        out += BASE64[n >> 18];
+        out += BASE64[(n >> 12) & 63];
+        out += "==";
+    } else if (i + 2 == data.size()) {
+        uint32_t n = (U_CHAR)data[i] << 16 | (U_CHAR)data[i + 1] << 8;
+        out += BASE64[n >> 18];
+        out += BASE64[(n >> 12) & 63];
+        out += BASE64[(n >> 6) & 63];
+        out += '=';
+    }
+}
+
+// JSON string of valid UTF-8 text.
+static void append_json(std::string &out, std::string_view text)
+{
+    static const char HEX[] = "0123456789abcdef";
+
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if ((U_CHAR)c < 0x20) {
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 15];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+static void append_tsv(std::string &out, std::string_view text)
+{
+    for (char c : text) {
+        switch (c) {
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        default:
+            out += c;
+        }
+    }
+}
+
+SLOBExporter::SLOBExporter(SLOBReader &reader, SLOBThreadPool *pool)
+    : m_reader(reader), m_pool(pool)
+{
+}
+
+void SLOBExporter::set_format(EXPORT::FORMAT format)
+{
+    m_format = format;
+}
+
+void SLOBExporter::set_content_types(std::vector<std::string> content_types)
+{
+    m_content_types = std::move(content_types);
+}
+
+void SLOBExporter::set_key_range(const std::string &from, const std::string &to)
+{
+    m_from = from;
+    m_to = to;
+}
+
+void SLOBExporter::set_window(size_t window)
+{
+    m_window = window;
+}
+
+std::pair<U_INT, U_INT> SLOBExporter::reference_range() const
+{
+    CollationKeyList key_list(m_reader);
+
+    // First reference whose key does not collate before the bound.
+    auto lower_bound = [&](const std::string &key) {
+        std::string sortkey = key_list.sort_key(key);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(sortkey.data());
+        U_INT low = 0, high = m_reader.ref_count();
+        while (low < high) {
+            U_INT middle = low + (high - low) / 2;
+            bool before = m_reader.visit_reference(middle, [&](const SLOBReferenceView &ref) {
+                return key_list.compare(ref.key, bytes, sortkey.size()) < 0;
+            });
+            if (before)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low;
+    };
+
+    U_INT begin = m_from.empty() ? 0 : lower_bound(m_from);
+    U_INT end = m_to.empty() ? m_reader.ref_count() : lower_bound(m_to);
+    return { begin, std::max(begin, end) };
+}
+
+SLOBExporter::Chunk SLOBExporter::export_bin(U_INT bin_index, std::span<const U_INT> references,
+                                             const std::vector<bool> &content_types) const
+{
+    Chunk chunk;
+
+    // Skip bins whose referenced items are all filtered
+    // out, without decompressing them.
+    thread_local std::string compressed;
+    SLOBStoreItem store_item;
+    std::string_view content = m_reader.read_store_item(bin_index, store_item, compressed);
+
+    std::vector<U_INT> selected;
+    for (U_INT index : references) {
+        U_SHORT item_index = m_reader.visit_reference(index, [](const SLOBReferenceView &ref) {
+            return ref.item_index;
+        });
+        if (item_index >= store_item.content_type_ids.size())
+            throw std::runtime_error("SLOB: Reference to an item past the end of its bin");
+        U_CHAR content_type_id = store_item.content_type_ids[item_index];
+        if (content_type_id >= content_types.size())
+            throw std::runtime_error("SLOB: Content type ID out of bounds");
+        if (content_types[content_type_id])
+            selected.push_back(index);
+    }
+    if (selected.empty())
+        return chunk;
+
+    m_reader.decompress(content, store_item.content);
+    SLOBStorageBin storage_bin(store_item, store_item.content_type_ids.size());
+
+    for (U_INT index : selected) {
+        m_reader.visit_reference(index, [&](const SLOBReferenceView &ref) {
+            std::string_view item = storage_bin.item(ref.item_index);
+            const std::string &content_type = m_reader.content_type(store_item.content_type_ids[ref.item_index]);
+            std::string &out = chunk.output;
+
+            if (m_format == EXPORT::TSV) {
+                append_tsv(out, ref.key);
+                out += '\t';
+                append_tsv(out, ref.fragment);
+                out += '\t';
+                append_tsv(out, content_type);
+                out += '\t';
+                append_tsv(out, item);
+                out += '\n';
+                return;
+            }
+
+            out += "{\"key\":";
+            append_json(out, ref.key);
+            out += ",\"fragment\":";
+            append_json(out, ref.fragment);
+            out += ",\"content_type\":";
+            append_json(out, content_type);
+            out += ",\"content\":";
+            if (valid_utf8(item)) {
+                append_json(out, item);
+            } else {
+                out += '"';
+                append_base64(out, item);
+                out += "\",\"encoding\":\"base64\"";
+            }
+            out += "}\n";
+        });
+        chunk.records++;
+    }
+
+    return chunk;
+}
+
+size_t SLOBExporter::write(std::ostream &out) const
+{
+    // Content types selected by the filter, by id.
+    std::vector<bool> content_types;
+    m_reader.for_each_content_type([&](const std::string &content_type) {
+        bool selected = m_content_types.empty();
+        std::string_view type = std::string_view(content_type).substr(0, content_type.find(';'));
+        for (const std::string &filter : m_content_types)
+            if (filter == content_type || filter == type)
+                selected = true;
+        content_types.push_back(selected);
+        return ITERATION::CONTINUE;
+    });
+
+    // Group the references in the range by bin, in collation
+    // order within each bin (a counting sort).
+    auto [begin, end] = reference_range();
+    std::vector<U_INT> bin_offsets(m_reader.bin_count() + 1, 0);
+    std::vector<U_INT> bins(end - begin);
+    for (U_INT i = begin; i < end; i++) {
+        U_INT bin_index = m_reader.visit_reference(i, [](const SLOBReferenceView &ref) {
+            return ref.bin_index;
+        });
+        if (bin_index >= m_reader.bin_count())
+            throw std::runtime_error("SLOB: Reference to a bin past the end of the store");
+        bins[i - begin] = bin_index;
+        bin_offsets[bin_index + 1]++;
+    }
+    for (U_INT bin_index = 0; bin_index < m_reader.bin_count(); bin_index++)
+        bin_offsets[bin_index + 1] += bin_offsets[bin_index];
+
+    std::vector<U_INT> references(end - begin);
+    std::vector<U_INT> next(bin_offsets.begin(), bin_offsets.end() - 1);
+    for (U_INT i = begin; i < end; i++)
+        references[next[bins[i - begin]]++] = i;
+    std::vector<U_INT>().swap(bins);
+    std::vector<U_INT>().swap(next);
+
+    size_t records = 0;
+    auto emit = [&](const Chunk &chunk) {
+        out.write(chunk.output.data(), chunk.output.size());
+        if (!out)
+            throw std::runtime_error("SLOB: Could not write export");
+        records += chunk.records;
+    };
+
+    size_t window = m_window;
+    if (window == 0)
+        window = DEFAULT_BIN_WINDOW_PER_THREAD * (m_pool ? m_pool->size() : 1);
+
+    std::deque<std::future<Chunk>> pending;
+    try {
+        for (U_INT bin_index = 0; bin_index < m_reader.bin_count(); bin_index++) {
+            std::span<const U_INT> bin_references(references.data() + bin_offsets[bin_index],
+                                                  bin_offsets[bin_index + 1] - bin_offsets[bin_index]);
+            if (bin_references.empty())
+                continue;
+
+            if (!m_pool) {
+                emit(export_bin(bin_index, bin_references, content_types));
+                continue;
+            }
+
+            pending.push_back(m_pool->async([this, bin_index, bin_references, &content_types]() {
+                return export_bin(bin_index, bin_references, content_types);
+            }));
+            while (pending.size() >= window) {
+                Chunk chunk = pending.front().get();
+                pending.pop_front();
+                emit(chunk);
+            }
+        }
+        while (!pending.empty()) {
+            Chunk chunk = pending.front().get();
+            pending.pop_front();
+            emit(chunk);
+        }
+    } catch (...) {
+        // Tasks still in flight reference this frame. The future
+        // whose get() threw is no longer valid.
+        for (std::future<Chunk> &chunk : pending)
+            if (chunk.valid())
+                chunk.wait();
+        throw;
+    }
+
+    out.flush();
+    return records;
+}
@@ -0,0 +1,153 @@
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <unicode/uchar.h>
+#include <unicode/unistr.h>
+#include <unicode/normalizer2.h>
+#include "folding.h"
+
+U_NAMESPACE_USE
+
+// Table: key count, reference count, key offsets and reference
+// offsets (count + 1 each), reference indexes and the key bytes.
+#define FOLDED_KEY_TABLE_HEADER_SIZE (2 * U_INT_SIZE)
+
+std::string fold_key(std::string_view key)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    const Normalizer2 *nfd = Normalizer2::getNFDInstance(status);
+    if (U_FAILURE(status))
+        throw std::runtime_error("ICU: error has occurred");
+
+    UnicodeString u_string = UnicodeString::fromUTF8(StringPiece(key.data(), key.size()));
+    UnicodeString decomposed = nfd->normalize(u_string.foldCase(), status);
+    if (U_FAILURE(status))
+        throw std::runtime_error("ICU: error has occurred");
+
+    UnicodeString folded;
+    for (int32_t i = 0; i < decomposed.length(); i = decomposed.moveIndex32(i, 1)) {
+        UChar32 c = decomposed.char32At(i);
+        if (u_charType(c) != U_NON_SPACING_MARK)
+            folded.append(c);
+    }
+
+    std::string result;
+    folded.toUTF8String(result);
+    return result;
+}
+
+void SLOBFoldedKeyTable::build(const SLOBReader &reader)
+{
+    std::vector<std::string> folded;
+    folded.reserve(reader.ref_count());
+    reader.for_each_reference([&](auto &ref) {
+        folded.push_back(fold_key(ref.key));
+        return ITERATION::CONTINUE;
+    });
+
+    std::vector<U_INT> order(folded.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](U_INT a, U_INT b) {
+        return folded[a] < folded[b];
+    });
+
+    std::string keys;
+    std::vector<U_INT> key_offsets, reference_offsets;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == 0 || folded[order[i]] != folded[order[i - 1]]) {
+            key_offsets.push_back(keys.size());
+            reference_offsets.push_back(i);
+            keys.append(folded[order[i]]);
+        }
+    }
+    key_offsets.push_back(keys.size());
+    reference_offsets.push_back(order.size());
+
+    m_built.clear();
+    append_int(m_built, key_offsets.size() - 1);
+    append_int(m_built, order.size());
+    for (U_INT offset : key_offsets)
+        append_int(m_built, offset);
+    for (U_INT offset : reference_offsets)
+        append_int(m_built, offset);
+    for (U_INT index : order)
+        append_int(m_built, index);
+    m_built.append(keys);
+
+    view(m_built, reader);
+}
+
+void SLOBFoldedKeyTable::write(SLOBSidecarWriter &writer) const
+{
+    writer.write(m_built);
+}
+
+size_t SLOBFoldedKeyTable::view(std::string_view data, const SLOBReader &reader)
+{
+    if (data.size() < FOLDED_KEY_TABLE_HEADER_SIZE)
+        throw std::runtime_error("SLOB: Folded key table is truncated");
+
+    U_INT key_count = load_int(data.data());
+    U_INT reference_count = load_int(data.data() + U_INT_SIZE);
+    size_t tables_size = ((size_t)key_count + 1) * 2 * U_INT_SIZE + (size_t)reference_count * U_INT_SIZE;
+    if (reference_count != reader.ref_count() || key_count > reference_count
+            || data.size() < FOLDED_KEY_TABLE_HEADER_SIZE + tables_size)
+        throw std::runtime_error("SLOB: Folded key table is corrupt");
+
+    m_key_offsets = data.data() + FOLDED_KEY_TABLE_HEADER_SIZE;
+    m_reference_offsets = m_key_offsets + ((size_t)key_count + 1) * U_INT_SIZE;
+    m_references = m_reference_offsets + ((size_t)key_count + 1) * U_INT_SIZE;
+
+    size_t keys_size = load_int(m_key_offsets + (size_t)key_count * U_INT_SIZE);
+    if (data.size() - FOLDED_KEY_TABLE_HEADER_SIZE - tables_size < keys_size
+            || load_int(m_reference_offsets + (size_t)key_count * U_INT_SIZE) != reference_count)
+        throw std::runtime_error("SLOB: Folded key table is corrupt");
+
+    m_key_count = key_count;
+    m_reference_count = reference_count;
+    m_keys = data.substr(FOLDED_KEY_TABLE_HEADER_SIZE + tables_size, keys_size);
+    return FOLDED_KEY_TABLE_HEADER_SIZE + tables_size + keys_size;
+}
+
+U_INT SLOBFoldedKeyTable::key_offset(U_INT index) const
+{
+    return load_int(m_key_offsets + (size_t)index * U_INT_SIZE);
+}
+
+std::string_view SLOBFoldedKeyTable::key(U_INT index) const
+{
+    U_INT begin = key_offset(index);
+    U_INT end = key_offset(index + 1);
+    if (begin > end || end > m_keys.size())
+        throw std::runtime_error("SLOB: Folded key table is corrupt");
+    return m_keys.substr(begin, end - begin);
+}
+
+U_INT SLOBFoldedKeyTable::key_at(U_INT offset) const
+{
+    // Last key starting at or before the offset.
+    U_INT low = 0, high = m_key_count > 0 ? m_key_count - 1 : 0;
+    while (low < high) {
+        U_INT middle = low + (high - low + 1) / 2;
+        if (key_offset(middle) <= offset)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+std::pair<U_INT, U_INT> SLOBFoldedKeyTable::references(U_INT index) const
+{
+    U_INT begin = load_int(m_reference_offsets + (size_t)index * U_INT_SIZE);
+    U_INT end = load_int(m_reference_offsets + ((size_t)index + 1) * U_INT_SIZE);
+    if (begin > end || end > m_reference_count)
+        throw std::runtime_error("SLOB: Folded key table is corrupt");
+    return { begin, end };
+}
+
+U_INT SLOBFoldedKeyTable::reference(U_INT slot) const
+{
+    return load_int(m_references + (size_t)slot * U_INT_SIZE);
+}
@@ -0,0 +1,137 @@
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <unicode/utf8.h>
+#include "folding.h"
+#include "fuzzy_index.h"
+
+void SLOBFuzzyIndex::build(const SLOBReader &reader, const char *path)
+{
+    SLOBFoldedKeyTable table;
+    table.build(reader);
+
+    SLOBSidecarWriter writer(path, FUZZY_INDEX_MAGIC, reader);
+    table.write(writer);
+    writer.commit();
+}
+
+void SLOBFuzzyIndex::open(const char *path, const SLOBReader &reader)
+{
+    // Opening unmaps the previous index, so a failed
+    // open must not leave the table viewing it.
+    m_open = false;
+    m_table = SLOBFoldedKeyTable();
+    m_sidecar.open(path, FUZZY_INDEX_MAGIC, reader);
+    m_table.view(m_sidecar.data(), reader);
+    m_open = true;
+}
+
+U_INT SLOBFuzzyIndex::skip_prefix(U_INT begin, std::string_view prefix) const
+{
+    U_INT low = begin, high = m_table.size();
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        if (m_table.key(middle).starts_with(prefix))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+std::vector<SLOBFuzzyHit> SLOBFuzzyIndex::search(std::string_view term, U_INT max_distance,
+                                                   size_t limit) const
+{
+    if (!m_open)
+        throw std::runtime_error("SLOB: Fuzzy index is not open");
+
+    std::string folded = fold_key(term);
+    std::vector<UChar32> query;
+    for (int32_t i = 0; i < (int32_t)folded.size();) {
+        UChar32 c;
+        U8_NEXT(folded.data(), i, (int32_t)folded.size(), c);
+        query.push_back(c);
+    }
+    const size_t m = query.size();
+
+    // rows[d] is the Levenshtein row after the first d code
+    // points of the current key, chars[d - 1] the last one.
+    // Rows are valid up to depth valid, and shared with the
+    // next key as far as the keys share code points.
+    std::vector<std::vector<U_INT>> rows(1, std::vector<U_INT>(m + 1));
+    std::iota(rows[0].begin(), rows[0].end(), 0);
+    std::vector<UChar32> chars;
+    size_t valid = 0;
+
+    std::vector<std::pair<U_INT, U_INT>> found;
+    for (U_INT index = 0; index < m_table.size();) {
+        std::string_view key = m_table.key(index);
+        const char *bytes = key.data();
+        int32_t length = key.size();
+
+        // Keep the rows of the code points shared with the previous key.
+        size_t depth = 0;
+        int32_t offset = 0;
+        while (depth < valid && offset < length) {
+            UChar32 c;
+            int32_t next = offset;
+            U8_NEXT(bytes, next, length, c);
+            if (c != chars[depth])
+                break;
+            offset = next;
+            depth++;
+        }
+
+        bool pruned = false;
+        while (offset < length) {
+            UChar32 c;
+            U8_NEXT(bytes, offset, length, c);
+            depth++;
+            if (rows.size() <= depth) {
+                rows.emplace_back(m + 1);
+                chars.push_back(0);
+            }
+            chars[depth - 1] = c;
+
+            const std::vector<U_INT> &previous = rows[depth - 1];
+            std::vector<U_INT> &row = rows[depth];
+            row[0] = depth;
+            U_INT best = row[0];
+            for (size_t j = 1; j <= m; j++) {
+                row[j] = std::min({ previous[j] + 1, row[j - 1] + 1,
+                                    previous[j - 1] + (query[j - 1] != c) });
+                best = std::min(best, row[j]);
+            }
+
+            // No key continuing this prefix can come back in range.
+            if (best > max_distance) {
+                valid = depth - 1;
+                index = skip_prefix(index, key.substr(0, offset));
+                pruned = true;
+                break;
+            }
+        }
+        if (pruned)
+            continue;
+
+        valid = depth;
+        if (rows[depth][m] <= max_distance)
+            found.emplace_back(rows[depth][m], index);
+        index++;
+    }
+
+    std::stable_sort(found.begin(), found.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+    if (limit > 0 && found.size() > limit)
+        found.resize(limit);
+
+    std::vector<SLOBFuzzyHit> matches;
+    for (auto [distance, index] : found) {
+        auto [begin, end] = m_table.references(index);
+        for (U_INT slot = begin; slot < end; slot++)
+            matches.push_back({ m_table.reference(slot), distance });
+    }
+    return matches;
+}
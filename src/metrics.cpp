@@ -0,0 +1,237 @@
+#include "metrics.h"
+#include <bit>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdio>
+#include <algorithm>
+
+struct MetricInfo {
+    const char *name;
+    const char *labels;
+    const char *help;
+};
+
+static const MetricInfo COUNTERS[METRIC::COUNTER_COUNT] = {
+    { "slob_files_opened_total", "", "SLOB files opened." },
+    { "slob_lookups_total", "", "Dictionary lookups." },
+    { "slob_lookup_matches_total", "", "References returned by lookups." },
+    { "slob_lookups_filtered_total", "", "Lookups answered by a filter without searching." },
+    { "slob_key_comparisons_total", "", "Collation key comparisons while searching." },
+    { "slob_reference_reads_total", "", "References decoded from files after opening." },
+    { "slob_bin_reads_total", "", "Compressed bins read." },
+    { "slob_file_reads_total", "", "Positional reads from unmapped files." },
+    { "slob_read_bytes_total", "", "Bytes read from unmapped files." },
+    { "slob_mapped_bytes_total", "", "Bytes read or viewed in mapped files." },
+    { "slob_compressed_bytes_total", "codec=\"lzma2\"", "Compressed bytes decompressed." },
+    { "slob_compressed_bytes_total", "codec=\"zlib\"", "Compressed bytes decompressed." },
+    { "slob_compressed_bytes_total", "codec=\"none\"", "Compressed bytes decompressed." },
+    { "slob_decompressed_bytes_total", "codec=\"lzma2\"", "Bytes produced by decompression." },
+    { "slob_decompressed_bytes_total", "codec=\"zlib\"", "Bytes produced by decompression." },
+    { "slob_decompressed_bytes_total", "codec=\"none\"", "Bytes produced by decompression." },
+    { "slob_bin_cache_hits_total", "", "Bin cache hits." },
+    { "slob_bin_cache_misses_total", "", "Bin cache misses." },
+    { "slob_bin_cache_evictions_total", "", "Bins evicted from bin caches." },
+};
+
+static const MetricInfo HISTOGRAMS[METRIC::HISTOGRAM_COUNT] = {
+    { "slob_open_seconds", "phase=\"total\"", "Time opening SLOB files, by phase." },
+    { "slob_open_seconds", "phase=\"parse_header\"", "Time opening SLOB files, by phase." },
+    { "slob_open_seconds", "phase=\"read_reference_positions\"", "Time opening SLOB files, by phase." },
+    { "slob_open_seconds", "phase=\"read_references\"", "Time opening SLOB files, by phase." },
+    { "slob_open_seconds", "phase=\"read_store_item_positions\"", "Time opening SLOB files, by phase." },
+    { "slob_lookup_seconds", "", "Time of complete dictionary lookups." },
+    { "slob_sort_key_seconds", "", "Time collating lookup terms into sort keys." },
+    { "slob_file_read_seconds", "", "Positional read time from unmapped files." },
+    { "slob_bin_read_seconds", "", "Time locating and reading compressed bins." },
+    { "slob_decompress_seconds", "codec=\"lzma2\"", "Decompression time." },
+    { "slob_decompress_seconds", "codec=\"zlib\"", "Decompression time." },
+};
+
+// Span names, as in the histogram labels.
+static const char *OPERATIONS[METRIC::HISTOGRAM_COUNT] = {
+    "open_file",
+    "parse_header",
+    "read_reference_positions",
+    "read_references",
+    "read_store_item_positions",
+    "lookup",
+    "sort_key",
+    "file_read",
+    "bin_read",
+    "decompress_lzma2",
+    "decompress_zlib",
+};
+
+// Metrics are spread over shards, each updated by a few threads
+// and on its own cache lines, so threads do not contend on every
+// update. Snapshots add the shards up.
+#define METRICS_SHARDS 16
+
+struct Histogram {
+    std::atomic<uint64_t> buckets[METRICS_BUCKET_COUNT] {};
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> sum_ns { 0 };
+};
+
+struct alignas(64) Shard {
+    std::atomic<uint64_t> counters[METRIC::COUNTER_COUNT] {};
+    Histogram histograms[METRIC::HISTOGRAM_COUNT];
+};
+
+static Shard shards[METRICS_SHARDS];
+
+static Shard &shard()
+{
+    static std::atomic<unsigned> next { 0 };
+    thread_local Shard &shard = shards[next.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS];
+    return shard;
+}
+
+static std::atomic<bool> tracing { false };
+static std::mutex trace_mutex;
+static std::shared_ptr<const std::function<void(const SLOBSpan &)>> trace_sink;
+
+bool SLOBMetrics::enabled()
+{
+#ifdef SLOB_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SLOBMetrics::add(METRIC::COUNTER counter, uint64_t value)
+{
+    shard().counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+void SLOBMetrics::observe(METRIC::HISTOGRAM histogram, std::chrono::steady_clock::time_point start,
+                          std::chrono::nanoseconds duration)
+{
+    uint64_t ns = std::max<int64_t>(duration.count(), 0);
+
+    // Smallest bucket whose upper bound, 2^(first + i) ns, is not below ns.
+    int bucket = ns ? (int)std::bit_width(ns - 1) - METRICS_FIRST_BUCKET : 0;
+    bucket = std::clamp(bucket, 0, METRICS_BUCKET_COUNT - 1);
+
+    Histogram &h = shard().histograms[histogram];
+    h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    if (!tracing.load(std::memory_order_relaxed))
+        return;
+
+    std::shared_ptr<const std::function<void(const SLOBSpan &)>> sink;
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        sink = trace_sink;
+    }
+    if (sink)
+        (*sink)({ histogram, OPERATIONS[histogram], start, duration });
+}
+
+SLOBMetricsSnapshot SLOBMetrics::snapshot()
+{
+    SLOBMetricsSnapshot snapshot;
+
+    for (int i = 0; i < METRIC::COUNTER_COUNT; i++) {
+        SLOBCounterSnapshot counter { COUNTERS[i].name, COUNTERS[i].labels, 0 };
+        for (const Shard &shard : shards)
+            counter.value += shard.counters[i].load(std::memory_order_relaxed);
+        snapshot.counters.push_back(counter);
+    }
+
+    for (int i = 0; i < METRIC::HISTOGRAM_COUNT; i++) {
+        SLOBHistogramSnapshot histogram { HISTOGRAMS[i].name, HISTOGRAMS[i].labels, {}, 0, 0 };
+        for (const Shard &shard : shards) {
+            const Histogram &h = shard.histograms[i];
+            for (int b = 0; b < METRICS_BUCKET_COUNT; b++)
+                histogram.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+            histogram.count += h.count.load(std::memory_order_relaxed);
+            histogram.sum_ns += h.sum_ns.load(std::memory_order_relaxed);
+        }
+        snapshot.histograms.push_back(histogram);
+    }
+
+    return snapshot;
+}
+
+// Series name with its labels, and an extra label.
+static std::string series(const char *name, const char *labels, const std::string &extra = "")
+{
+    std::string all = labels;
+    if (!extra.empty())
+        all += (all.empty() ? "" : ",") + extra;
+    return all.empty() ? name : std::string(name) + "{" + all + "}";
+}
+
+std::string SLOBMetrics::prometheus()
+{
+    SLOBMetricsSnapshot metrics = snapshot();
+    std::string out;
+    const char *last = "";
+    char number[32];
+
+    for (int i = 0; i < METRIC::COUNTER_COUNT; i++) {
+        if (std::string(last) != COUNTERS[i].name) {
+            last = COUNTERS[i].name;
+            out += std::string("# HELP ") + last + " " + COUNTERS[i].help + "\n";
+            out += std::string("# TYPE ") + last + " counter\n";
+        }
+        out += series(last, COUNTERS[i].labels) + " " + std::to_string(metrics.counters[i].value) + "\n";
+    }
+
+    for (int i = 0; i < METRIC::HISTOGRAM_COUNT; i++) {
+        const SLOBHistogramSnapshot &histogram = metrics.histograms[i];
+        std::string name = HISTOGRAMS[i].name;
+        if (name != last) {
+            last = HISTOGRAMS[i].name;
+            out += "# HELP " + name + " " + HISTOGRAMS[i].help + "\n";
+            out += "# TYPE " + name + " histogram\n";
+        }
+
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRICS_BUCKET_COUNT; b++) {
+            cumulative += histogram.buckets[b];
+            std::string le = "+Inf";
+            if (b < METRICS_BUCKET_COUNT - 1) {
+                snprintf(number, sizeof(number), "%g", (double)(1ULL << (METRICS_FIRST_BUCKET + b)) / 1e9);
+                le = number;
+            }
+            out += series((name + "_bucket").c_str(), HISTOGRAMS[i].labels, "le=\"" + le + "\"") +
+                   " " + std::to_string(cumulative) + "\n";
+        }
+        snprintf(number, sizeof(number), "%.9f", histogram.sum_ns / 1e9);
+        out += series((name + "_sum").c_str(), HISTOGRAMS[i].labels) + " " + number + "\n";
+        out += series((name + "_count").c_str(), HISTOGRAMS[i].labels) + " " +
+               std::to_string(histogram.count) + "\n";
+    }
+
+    return out;
+}
+
+void SLOBMetrics::reset()
+{
+    for (Shard &shard : shards) {
+        for (auto &counter : shard.counters)
+            counter.store(0, std::memory_order_relaxed);
+        for (Histogram &histogram : shard.histograms) {
+            for (auto &bucket : histogram.buckets)
+                bucket.store(0, std::memory_order_relaxed);
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum_ns.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void SLOBMetrics::set_trace_sink(std::function<void(const SLOBSpan &)> sink)
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (sink)
+        trace_sink = std::make_shared<const std::function<void(const SLOBSpan &)>>(std::move(sink));
+    else
+        trace_sink.reset();
+    tracing.store(trace_sink != nullptr, std::memory_order_relaxed);
+}
@@ -0,0 +1,66 @@
+#include "slob.h"
+
+void SLOBReferenceTable::reserve(size_t count, size_t bytes)
+{
+    m_arena.reserve(bytes);
+    m_offsets.reserve(count);
+    m_key_lengths.reserve(count);
+    m_fragment_lengths.reserve(count);
+    m_bin_indexes.reserve(count);
+    m_item_indexes.reserve(count);
+}
+
+void SLOBReferenceTable::push_back(std::string_view key, U_INT bin_index,
+                                   U_SHORT item_index, std::string_view fragment)
+{
+    m_offsets.push_back(m_arena.size());
+    m_key_lengths.push_back(key.size());
+    m_fragment_lengths.push_back(fragment.size());
+    m_bin_indexes.push_back(bin_index);
+    m_item_indexes.push_back(item_index);
+    m_arena.append(key);
+    m_arena.append(fragment);
+}
+
+void SLOBReferenceTable::shrink_to_fit()
+{
+    m_arena.shrink_to_fit();
+    m_offsets.shrink_to_fit();
+    m_key_lengths.shrink_to_fit();
+    m_fragment_lengths.shrink_to_fit();
+    m_bin_indexes.shrink_to_fit();
+    m_item_indexes.shrink_to_fit();
+}
+
+void SLOBReferenceTable::clear()
+{
+    m_arena.clear();
+    m_offsets.clear();
+    m_key_lengths.clear();
+    m_fragment_lengths.clear();
+    m_bin_indexes.clear();
+    m_item_indexes.clear();
+}
+
+SLOBReferenceView SLOBReferenceTable::operator[](size_t index) const
+{
+    std::string_view arena(m_arena);
+    U_LONG_LONG offset = m_offsets[index];
+    U_SHORT key_length = m_key_lengths[index];
+    return {
+        arena.substr(offset, key_length),
+        m_bin_indexes[index],
+        m_item_indexes[index],
+        arena.substr(offset + key_length, m_fragment_lengths[index]),
+    };
+}
+
+size_t SLOBReferenceTable::memory_usage() const
+{
+    return m_arena.capacity() +
+        m_offsets.capacity() * sizeof(U_LONG_LONG) +
+        m_key_lengths.capacity() * sizeof(U_SHORT) +
+        m_fragment_lengths.capacity() * sizeof(U_CHAR) +
+        m_bin_indexes.capacity() * sizeof(U_INT) +
+        m_item_indexes.capacity() * sizeof(U_SHORT);
+}
@@ -0,0 +1,94 @@
+#include "sidecar.h"
+#include <cstdio>
+#include <stdexcept>
+
+SLOBSidecarWriter::SLOBSidecarWriter(const char *path, const char *magic, const SLOBReader &reader)
+    : m_path(path), m_temp_path(std::string(path) + ".tmp")
+{
+    m_out.open(m_temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_out)
+        throw std::invalid_argument("SLOB: Could not create sidecar file");
+
+    std::string uuid = reader.uuid();
+    m_out.write(magic, SIDECAR_MAGIC_LEN);
+    write_int(SIDECAR_VERSION);
+    m_out.write(uuid.data(), uuid.size());
+    write_long(reader.size());
+    m_offset = 0;
+}
+
+SLOBSidecarWriter::~SLOBSidecarWriter()
+{
+    if (!m_committed) {
+        m_out.close();
+        std::remove(m_temp_path.c_str());
+    }
+}
+
+void SLOBSidecarWriter::write(std::string_view bytes)
+{
+    m_out.write(bytes.data(), bytes.size());
+    m_offset += bytes.size();
+}
+
+void SLOBSidecarWriter::write_byte(U_CHAR value)
+{
+    m_out.put(value);
+    m_offset++;
+}
+
+void SLOBSidecarWriter::write_int(U_INT value)
+{
+    char bytes[U_INT_SIZE];
+    for (int i = 0; i < U_INT_SIZE; i++)
+        bytes[i] = value >> (8 * i);
+    write(std::string_view(bytes, U_INT_SIZE));
+}
+
+void SLOBSidecarWriter::write_long(U_LONG_LONG value)
+{
+    write_int(value);
+    write_int(value >> 32);
+}
+
+void SLOBSidecarWriter::write_varint(U_LONG_LONG value)
+{
+    while (value >= 0x80) {
+        write_byte((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    write_byte(value);
+}
+
+void SLOBSidecarWriter::commit()
+{
+    m_out.close();
+    if (!m_out)
+        throw std::runtime_error("SLOB: Could not write sidecar file");
+    if (std::rename(m_temp_path.c_str(), m_path.c_str()) != 0)
+        throw std::runtime_error("SLOB: Could not rename sidecar file");
+    m_committed = true;
+}
+
+void SLOBSidecar::open(const char *path, const char *magic, const SLOBReader &reader)
+{
+    m_data = std::string_view();
+    m_file.open(path, BACKEND::MMAP);
+
+    const size_t header_size = SIDECAR_MAGIC_LEN + U_INT_SIZE + 16 + U_LONG_LONG_SIZE;
+    if (m_file.size() < header_size)
+        throw std::runtime_error("SLOB: Sidecar file is truncated");
+
+    std::string_view header = m_file.view(0, header_size);
+    if (header.substr(0, SIDECAR_MAGIC_LEN) != std::string_view(magic, SIDECAR_MAGIC_LEN))
+        throw std::runtime_error("SLOB: Incorrect sidecar magic value");
+    if (load_int(header.data() + SIDECAR_MAGIC_LEN) != SIDECAR_VERSION)
+        throw std::runtime_error("SLOB: Unsupported sidecar version");
+
+    std::string_view uuid = header.substr(SIDECAR_MAGIC_LEN + U_INT_SIZE, 16);
+    U_LONG_LONG size = load_long(header.data() + SIDECAR_MAGIC_LEN + U_INT_SIZE + 16);
+    if (uuid != reader.uuid() || size != reader.size())
+        throw std::runtime_error("SLOB: Sidecar file is stale (built from another SLOB file)");
+
+    m_data = m_file.view(header_size, m_file.size() - header_size);
+}
@@ -1,8 +1,11 @@
 #include "slob.h"
+#include "metrics.h"
 #include <cstring>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <exception>
+#include <condition_variable>
 #include <unicode/unistr.h>
 #include <unicode/ustream.h>
 
@@ -56,80 +59,48 @@ void SLOBReader::print_header_info() const
     std::cout << m_header;
 }
 
-SLOBStorageBin::SLOBStorageBin(const SLOBStoreItem &store_item, U_INT item_count)
-    : m_store_item(store_item), m_item_count(item_count)
-{
-    m_stream.str(m_store_item.content);
-    m_item_positions.reserve(m_item_count);
-    for (U_INT i = 0; i < m_item_count; i++)
-        m_item_positions.push_back(read_int());
-    m_items_data_offset = m_stream.tellg(); 
-}
-
-template <typename LenSpec>
-std::string SLOBStorageBin::read_byte_string()
-{
-    std::string length_bytes(sizeof(LenSpec), '\0');
-    m_stream.read(&length_bytes[0], sizeof(LenSpec));
-    std::reverse(length_bytes.begin(), length_bytes.end());
-
-    LenSpec length;
-    std::memcpy(&length, &length_bytes[0], sizeof(LenSpec));
-
-    std::string read_bytes(length, '\0');
-    m_stream.read(&read_bytes[0], length);
-    return read_bytes;
-}
-
-template <typename LenSpec>
-std::string SLOBStorageBin::_read_text()
+SLOBStorageBin::SLOBStorageBin(std::string_view content, U_INT item_count)
+    : m_content(content), m_item_count(item_count)
 {
-    size_t max_len = calcmax(LenSpec);
-    std::string byte_string = read_byte_string<LenSpec>();
-    if (byte_string.length() == max_len) {
-        size_t terminator = byte_string.find('\0');
-        if (terminator != std::string::npos) {
-           byte_string = byte_string.substr(0, terminator);
-        }
-    }
-    return byte_string;
+    m_items_data_offset = (size_t)m_item_count * U_INT_SIZE;
+    if (m_items_data_offset > m_content.size())
+        throw std::runtime_error("SLOB: SLOBStorageBin item positions are truncated");
 }
 
-std::string SLOBStorageBin::read_tiny_text()
+SLOBStorageBin::SLOBStorageBin(const SLOBStoreItem &store_item, U_INT item_count)
+    : SLOBStorageBin(std::string_view(store_item.content), item_count)
 {
-    return _read_text<U_CHAR>();
 }
 
-std::string SLOBStorageBin::read_text()
+U_INT SLOBStorageBin::read_int(size_t offset) const
 {
-    return _read_text<U_SHORT>();
-}
+    if (offset + U_INT_SIZE > m_content.size())
+        throw std::runtime_error("SLOB: SLOBStorageBin item is truncated");
 
-U_INT SLOBStorageBin::read_int()
-{
     U_INT read;
-    m_stream.read(reinterpret_cast<char *>(&read), sizeof(read));
+    std::memcpy(&read, m_content.data() + offset, sizeof(read));
     if (little_endian())
         read = swap_endian(read);
     return read;
 }
 
-std::string SLOBStorageBin::next()
+std::string_view SLOBStorageBin::next()
 {
-    return read_text();
+    return item(m_next++);
 }
 
-std::string SLOBStorageBin::item(U_SHORT index)
+std::string_view SLOBStorageBin::item(U_SHORT index) const
 {
-    if (index > m_item_count)
+    if (index >= m_item_count)
         throw std::runtime_error("SLOB: SLOBStorageBin::item() index out of bounds");
 
-    m_stream.seekg(m_items_data_offset + m_item_positions[index]);
-    U_INT length = read_int();
-    std::string buffer;
-    buffer.resize(length);
-    m_stream.read(&buffer[0], length);
-    return buffer;
+    size_t offset = m_items_data_offset + read_int((size_t)index * U_INT_SIZE);
+    U_INT length = read_int(offset);
+    offset += U_INT_SIZE;
+    if (length > m_content.size() - offset)
+        throw std::runtime_error("SLOB: SLOBStorageBin item is truncated");
+
+    return m_content.substr(offset, length);
 }
 
 SLOBReader::SLOBReader()
@@ -138,245 +109,652 @@ SLOBReader::SLOBReader()
 
 SLOBReader::~SLOBReader()
 {
-    m_fp.close();
+    m_file.close();
 }
 
-template <typename LenSpec>
-std::string SLOBReader::read_byte_string()
+// Text of the maximum length may be padded with zero bytes.
+static std::string_view strip_padding(std::string_view text, size_t max_len)
 {
-    std::string length_bytes(sizeof(LenSpec), '\0');
-    m_fp.read(&length_bytes[0], sizeof(LenSpec));
-    std::reverse(length_bytes.begin(), length_bytes.end());
+    if (text.length() == max_len) {
+        size_t terminator = text.find('\0');
+        if (terminator != std::string_view::npos)
+           text = text.substr(0, terminator);
+    }
+    return text;
+}
 
-    LenSpec length;
-    std::memcpy(&length, &length_bytes[0], sizeof(LenSpec));
+template <typename LenSpec>
+std::string SLOBReader::read_byte_string(SLOBCursor &cur) const
+{
+    LenSpec length = read_number<LenSpec>(cur);
 
     std::string read_bytes(length, '\0');
-    m_fp.read(&read_bytes[0], length);
+    cur.read(&read_bytes[0], length);
     return read_bytes;
 }
 
 template <typename LenSpec>
-std::string SLOBReader::_read_text()
+std::string_view SLOBReader::view_byte_string(SLOBCursor &cur) const
+{
+    LenSpec length = read_number<LenSpec>(cur);
+    return cur.view(length);
+}
+
+template <typename LenSpec>
+std::string SLOBReader::_read_text(SLOBCursor &cur) const
 {
     size_t max_len = calcmax(LenSpec);
-    std::string byte_string = read_byte_string<LenSpec>();
-    if (byte_string.length() == max_len) {
-        size_t terminator = byte_string.find('\0');
-        if (terminator != std::string::npos)
-           byte_string = byte_string.substr(0, terminator);
-    }
+    std::string byte_string = read_byte_string<LenSpec>(cur);
+    if (byte_string.length() == max_len)
+        byte_string = std::string(strip_padding(byte_string, max_len));
     return byte_string;
 }
 
-std::string SLOBReader::read_tiny_text()
+template <typename T>
+T SLOBReader::read_number(SLOBCursor &cur) const
+{
+    T read;
+    cur.read(reinterpret_cast<char *>(&read), sizeof(read));
+    if (little_endian())
+        read = swap_endian(read);
+    return read;
+}
+
+std::string SLOBReader::read_tiny_text(SLOBCursor &cur) const
 {
-    return _read_text<U_CHAR>();
+    return _read_text<U_CHAR>(cur);
 }
 
-std::string SLOBReader::read_text()
+std::string SLOBReader::read_text(SLOBCursor &cur) const
 {
-    return _read_text<U_SHORT>();
+    return _read_text<U_SHORT>(cur);
 }
 
-U_INT SLOBReader::read_int()
+U_INT SLOBReader::read_int(SLOBCursor &cur) const
 {
-    U_INT read;
-    m_fp.read(reinterpret_cast<char *>(&read), sizeof(read));
-    if (little_endian())
-        read = swap_endian(read);
-    return read;
+    return read_number<U_INT>(cur);
 }
 
-U_LONG_LONG SLOBReader::read_long()
+U_LONG_LONG SLOBReader::read_long(SLOBCursor &cur) const
 {
-    U_LONG_LONG read;
-    m_fp.read(reinterpret_cast<char *>(&read), sizeof(read));
-    if (little_endian())
-        read = swap_endian(read);
-    return read;
+    return read_number<U_LONG_LONG>(cur);
 }
 
-U_CHAR SLOBReader::read_byte()
+U_CHAR SLOBReader::read_byte(SLOBCursor &cur) const
 {
-    char read;
-    m_fp.read(&read, 1);
-    return (U_CHAR)read;
+    return read_number<U_CHAR>(cur);
 }
 
-U_SHORT SLOBReader::read_short()
+U_SHORT SLOBReader::read_short(SLOBCursor &cur) const
 {
-    U_SHORT read;
-    m_fp.read(reinterpret_cast<char *>(&read), sizeof(read));
-    if (little_endian())
-        read = swap_endian(read);
-    return read;
+    return read_number<U_SHORT>(cur);
 }
 
-void SLOBReader::open_file(const char *filename)
+void SLOBReader::open_file(const char *filename, REFERENCES::LOADING loading, BACKEND::TYPE backend)
 {
-    m_fp.open(filename, std::ios::in | std::ios::binary);
-    if (!m_fp)
-        throw std::invalid_argument("SLOB: Could not open SLOB file");
+    SLOB_TIME(OPEN_FILE);
+    SLOB_COUNT(FILES_OPENED, 1);
+    m_loading = loading;
+
+    // Drop everything read from a previously opened file.
+    m_header = SLOBHeader();
+    m_codec = nullptr;
+    m_references.clear();
+    m_reference_positions.clear();
+    m_store_item_positions.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_reference_cache_mutex);
+        m_reference_cache.clear();
+        m_reference_cache_index.clear();
+    }
+    m_bin_cache.clear();
 
-    m_fp.seekg(0, m_fp.end);
-    m_filesize = m_fp.tellg();
-    m_fp.seekg(0, m_fp.beg);
+    m_file.open(filename, backend);
 
     parse_header();
     read_reference_positions();
-    read_references();
+    if (m_loading == REFERENCES::EAGER)
+        read_references();
     read_store_item_positions();
 }
 
+void SLOBReader::set_reference_cache_size(size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_reference_cache_mutex);
+    m_reference_cache_size = size;
+    while (m_reference_cache.size() > m_reference_cache_size) {
+        m_reference_cache_index.erase(m_reference_cache.back().first);
+        m_reference_cache.pop_back();
+    }
+}
+
+void SLOBReader::set_bin_cache_size(size_t size)
+{
+    m_bin_cache.set_budget(size);
+}
+
+SLOBCacheStats SLOBReader::bin_cache_stats() const
+{
+    return m_bin_cache.stats();
+}
+
+void SLOBReader::advise(ACCESS::PATTERN pattern) const
+{
+    m_file.advise(pattern);
+}
+
 void SLOBReader::parse_header()
 {
+    SLOB_TIME(PARSE_HEADER);
+    SLOBCursor cur(m_file, 0);
+
     std::string read_magic(8, '\0');
-    m_fp.read(&read_magic[0], 8);
+    cur.read(&read_magic[0], 8);
 
     if (read_magic.compare(MAGIC) != 0)
         throw std::runtime_error("SLOB: Incorrect magic text value");
 
-    m_fp.read(&(m_header.uuid[0]), 16);
+    m_header.uuid.resize(16);
+    cur.read(&m_header.uuid[0], 16);
 
-    m_header.encoding = read_byte_string<U_CHAR>();
+    m_header.encoding = read_byte_string<U_CHAR>(cur);
     if (m_header.encoding.compare(UTF8) != 0)
         throw std::runtime_error("SLOB: Encoding unsupported (utf-8 only)");
 
-    m_header.compression = read_tiny_text();
+    m_header.compression = read_tiny_text(cur);
 
     if (!m_header.compression.empty())
-        decompress = COMPRESSION.at(m_header.compression);
+        m_codec = COMPRESSION.at(m_header.compression);
 
-    U_CHAR count = read_byte();
+    U_CHAR count = read_byte(cur);
     for (U_CHAR i = 0; i < count; i++) {
-        m_header.tags.insert(std::make_pair(read_tiny_text(), read_tiny_text()));
+        std::string key = read_tiny_text(cur);
+        m_header.tags.insert(std::make_pair(key, read_tiny_text(cur)));
     }
 
-    count = read_byte();
+    count = read_byte(cur);
     for (U_CHAR i = 0; i < count; i++) {
-        m_header.content_types.push_back(read_text());
+        m_header.content_types.push_back(read_text(cur));
     }
 
-    m_header.blob_count = read_int();
-    m_header.store_offset = read_long();
-    if (m_header.store_offset > m_filesize)
+    m_header.blob_count = read_int(cur);
+    m_header.store_offset = read_long(cur);
+    if (m_header.store_offset > m_file.size())
         throw std::runtime_error("SLOB: Store offset too large");
 
-    m_header.size = read_long();
-    m_header.refs_offset = m_fp.tellg();
+    m_header.size = read_long(cur);
+    m_header.refs_offset = cur.offset();
 
-    if (m_filesize != m_header.size)
+    if (m_file.size() != m_header.size)
         throw std::runtime_error("SLOB: Incorrect filesize");
 }
 
 void SLOBReader::read_store_item_positions()
 {
-    m_fp.seekg(m_header.store_offset);
-    U_INT item_positions_count = read_int();
-
-    m_store_item_positions.reserve(item_positions_count);
-
-    for (U_INT i = 0; i < item_positions_count; i++)
-        m_store_item_positions.push_back(read_long());
-
-    m_store_items_data_offset = m_fp.tellg();
+    SLOB_TIME(READ_STORE_ITEM_POSITIONS);
+    SLOBCursor cur(m_file, m_header.store_offset);
+    m_store_item_count = read_int(cur);
+    m_store_item_positions_offset = cur.offset();
+    m_store_items_data_offset = cur.offset() + (U_LONG_LONG)m_store_item_count * U_LONG_LONG_SIZE;
+    if (m_store_items_data_offset > m_header.size)
+        throw std::runtime_error("SLOB: Store item count too large");
+
+    if (m_file.mapped())
+        return;
+
+    m_store_item_positions.resize(m_store_item_count);
+    cur.read(reinterpret_cast<char *>(m_store_item_positions.data()),
+             (U_LONG_LONG)m_store_item_count * U_LONG_LONG_SIZE);
+    if (little_endian())
+        for (U_LONG_LONG &position : m_store_item_positions)
+            position = swap_endian(position);
 }
 
 void SLOBReader::read_reference_positions()
 {
-    m_fp.seekg(m_header.refs_offset);
-    U_INT reference_positions_count = read_int();
+    SLOB_TIME(READ_REFERENCE_POSITIONS);
+    SLOBCursor cur(m_file, m_header.refs_offset);
+    m_reference_count = read_int(cur);
+    m_reference_positions_offset = cur.offset();
+    m_reference_data_offset = cur.offset() + (U_LONG_LONG)m_reference_count * U_LONG_LONG_SIZE;
+    if (m_reference_data_offset > m_header.store_offset)
+        throw std::runtime_error("SLOB: Reference count too large");
+
+    if (m_file.mapped())
+        return;
+
+    m_reference_positions.resize(m_reference_count);
+    cur.read(reinterpret_cast<char *>(m_reference_positions.data()),
+             (U_LONG_LONG)m_reference_count * U_LONG_LONG_SIZE);
+    if (little_endian())
+        for (U_LONG_LONG &position : m_reference_positions)
+            position = swap_endian(position);
+}
 
-    m_reference_positions.reserve(reference_positions_count);
+U_LONG_LONG SLOBReader::reference_position(U_INT index) const
+{
+    if (!m_file.mapped())
+        return m_reference_positions[index];
 
-    for (U_INT i = 0; i < reference_positions_count; i++)
-        m_reference_positions.push_back(read_long());
+    SLOBCursor cur(m_file, m_reference_positions_offset + (U_LONG_LONG)index * U_LONG_LONG_SIZE);
+    return read_long(cur);
+}
 
-    m_reference_data_offset = m_fp.tellg();
+U_LONG_LONG SLOBReader::store_item_position(U_INT index) const
+{
+    if (!m_file.mapped())
+        return m_store_item_positions[index];
+
+    SLOBCursor cur(m_file, m_store_item_positions_offset + (U_LONG_LONG)index * U_LONG_LONG_SIZE);
+    return read_long(cur);
 }
 
 void SLOBReader::read_references()
 {
-    m_references.reserve(m_reference_positions.size());
-    for (U_LONG_LONG &position : m_reference_positions) {
-        m_fp.seekg(m_reference_data_offset + position);
-        m_references.push_back({
-            read_text(),
-            read_int(),
-            read_short(),
-            read_tiny_text()
-        });
+    SLOB_TIME(READ_REFERENCES);
+    // References are usually stored in order, so read the
+    // reference data ahead in large chunks.
+    SLOBCursor cur(m_file, m_reference_data_offset, REFERENCES_READ_BUFFER_SIZE);
+
+    m_references.clear();
+    m_references.reserve(m_reference_count, m_header.store_offset - m_reference_data_offset);
+    for (U_INT i = 0; i < m_reference_count; i++) {
+        cur.seek(m_reference_data_offset + reference_position(i));
+        SLOBReference ref = read_reference(cur);
+        m_references.push_back(ref.key, ref.bin_index, ref.item_index, ref.fragment);
     }
+    m_references.shrink_to_fit();
+}
+
+SLOBReference SLOBReader::read_reference(U_INT index) const
+{
+    SLOB_COUNT(REFERENCE_READS, 1);
+    SLOBCursor cur(m_file, m_reference_data_offset + reference_position(index));
+    return read_reference(cur);
 }
 
-std::string SLOBReader::content_type(U_CHAR id) const
+SLOBReference SLOBReader::read_reference(SLOBCursor &cur) const
 {
-    if (id > m_header.content_types.size())
+    SLOBReference ref;
+    ref.key = read_text(cur);
+    ref.bin_index = read_int(cur);
+    ref.item_index = read_short(cur);
+    ref.fragment = read_tiny_text(cur);
+    return ref;
+}
+
+const std::string &SLOBReader::content_type(U_CHAR id) const
+{
+    if (id >= m_header.content_types.size())
         throw std::runtime_error("SLOB: SLOBReader::content_type() ID is out of bounds");
 
     return m_header.content_types[id];
 }
 
-SLOBReference SLOBReader::reference(U_INT index)
+SLOBReference SLOBReader::reference(U_INT index) const
 {
-    if (index >= m_references.size())
+    if (index >= m_reference_count)
         throw std::runtime_error("SLOB: SLOBReader::reference() index out of bounds");
 
-    return m_references[index];
+    if (m_loading == REFERENCES::EAGER)
+        return to_reference(m_references[index]);
+
+    if (m_reference_cache_size == 0)
+        return read_reference(index);
+
+    {
+        std::lock_guard<std::mutex> lock(m_reference_cache_mutex);
+        auto cached = m_reference_cache_index.find(index);
+        if (cached != m_reference_cache_index.end()) {
+            m_reference_cache.splice(m_reference_cache.begin(), m_reference_cache, cached->second);
+            return cached->second->second;
+        }
+    }
+
+    // Decode outside of the lock; concurrent misses on the
+    // same index decode it twice, and keep the first copy.
+    SLOBReference ref = read_reference(index);
+
+    std::lock_guard<std::mutex> lock(m_reference_cache_mutex);
+    if (m_reference_cache_index.count(index))
+        return ref;
+
+    m_reference_cache.emplace_front(index, ref);
+    m_reference_cache_index[index] = m_reference_cache.begin();
+    if (m_reference_cache.size() > m_reference_cache_size) {
+        m_reference_cache_index.erase(m_reference_cache.back().first);
+        m_reference_cache.pop_back();
+    }
+
+    return ref;
+}
+
+SLOBReferenceView SLOBReader::reference_view(U_INT index) const
+{
+    if (index >= m_reference_count)
+        throw std::runtime_error("SLOB: SLOBReader::reference_view() index out of bounds");
+
+    if (m_loading == REFERENCES::EAGER)
+        return m_references[index];
+
+    if (!m_file.mapped())
+        throw std::runtime_error("SLOB: SLOBReader::reference_view() requires loaded references or a mapped file");
+
+    SLOBCursor cur(m_file, m_reference_data_offset + reference_position(index));
+    SLOBReferenceView ref;
+    ref.key = strip_padding(view_byte_string<U_SHORT>(cur), MAX_TEXT_LEN);
+    ref.bin_index = read_int(cur);
+    ref.item_index = read_short(cur);
+    ref.fragment = strip_padding(view_byte_string<U_CHAR>(cur), MAX_TINY_TEXT_LEN);
+    return ref;
 }
 
-SLOBStoreItem SLOBReader::store_item(U_INT index)
+SLOBStoreItemView SLOBReader::store_item_view(U_INT index) const
 {
-    if (index >= m_store_item_positions.size())
+    if (index >= m_store_item_count)
+        throw std::runtime_error("SLOB: SLOBReader::store_item_view() index out of bounds");
+    if (!m_file.mapped())
+        throw std::runtime_error("SLOB: SLOBReader::store_item_view() requires a mapped file");
+
+    SLOBCursor cur(m_file, m_store_items_data_offset + store_item_position(index));
+
+    SLOBStoreItemView item;
+    U_INT bin_item_count = read_int(cur);
+    item.content_type_ids = cur.view(bin_item_count);
+    item.content = view_byte_string<U_INT>(cur);
+    return item;
+}
+
+std::string_view SLOBReader::read_store_item(U_INT index, SLOBStoreItem &item, std::string &buffer) const
+{
+    if (index >= m_store_item_count)
         throw std::runtime_error("SLOB: SLOBReader::store_item() index out of bounds");
 
-    m_fp.seekg(m_store_items_data_offset + m_store_item_positions[index]);
+    SLOB_TIME(BIN_READ);
+    SLOB_COUNT(BIN_READS, 1);
+    SLOBCursor cur(m_file, m_store_items_data_offset + store_item_position(index));
+
+    U_INT bin_item_count = read_int(cur);
+    item.content_type_ids.resize(bin_item_count);
+    cur.read(reinterpret_cast<char *>(item.content_type_ids.data()), bin_item_count);
+
+    U_INT content_length = read_int(cur);
+    if (m_file.mapped())
+        return cur.view(content_length);
+
+    buffer.resize(content_length);
+    cur.read(&buffer[0], content_length);
+    return buffer;
+}
+
+SLOBStoreItem SLOBReader::store_item(U_INT index) const
+{
+    // Compressed content is read into a per thread buffer,
+    // and decompressed straight into the item.
+    thread_local std::string compressed;
 
     SLOBStoreItem item;
+    std::string_view content = read_store_item(index, item, compressed);
+    decompress(content, item.content);
+    return item;
+}
 
-    U_INT bin_item_count = read_int();
-    char packed_content_type_ids[bin_item_count];
-    m_fp.read(packed_content_type_ids, bin_item_count);
+U_INT SLOBReader::bin_item_count(U_INT index) const
+{
+    if (index >= m_store_item_count)
+        throw std::runtime_error("SLOB: SLOBReader::bin_item_count() index out of bounds");
 
-    for (unsigned int i = 0; i < bin_item_count; i++)
-        item.content_type_ids.push_back(packed_content_type_ids[i]);
+    SLOBCursor cur(m_file, m_store_items_data_offset + store_item_position(index));
+    return read_int(cur);
+}
 
-    U_INT content_length = read_int();
-    item.content.resize(content_length);
-    m_fp.read(&item.content[0], content_length);
+std::pair<U_LONG_LONG, size_t> SLOBReader::store_item_extent(U_INT index) const
+{
+    if (index >= m_store_item_count)
+        throw std::runtime_error("SLOB: SLOBReader::store_item() index out of bounds");
 
-    if (decompress)
-        item.content = decompress(item.content);
+    U_LONG_LONG begin = m_store_items_data_offset + store_item_position(index);
+    U_LONG_LONG end = index + 1 < m_store_item_count ?
+        m_store_items_data_offset + store_item_position(index + 1) : m_file.size();
+    if (begin >= end || end > m_file.size())
+        return { begin, 0 };
+    return { begin, end - begin };
+}
 
+SLOBStoreItem SLOBReader::decode_store_item(std::string_view record) const
+{
+    auto read_be = [&](size_t offset) {
+        if (offset + U_INT_SIZE > record.size())
+            throw std::runtime_error("SLOB: Store item is truncated");
+        U_INT value;
+        std::memcpy(&value, record.data() + offset, sizeof(value));
+        return little_endian() ? swap_endian(value) : value;
+    };
+
+    SLOBStoreItem item;
+    U_INT bin_item_count = read_be(0);
+    size_t offset = U_INT_SIZE;
+    if (bin_item_count > record.size() - offset)
+        throw std::runtime_error("SLOB: Store item is truncated");
+    item.content_type_ids.assign(record.begin() + offset, record.begin() + offset + bin_item_count);
+    offset += bin_item_count;
+
+    U_INT content_length = read_be(offset);
+    offset += U_INT_SIZE;
+    if (content_length > record.size() - offset)
+        throw std::runtime_error("SLOB: Store item is truncated");
+
+    decompress(record.substr(offset, content_length), item.content);
     return item;
 }
 
-std::string SLOBReader::item(U_INT bin_index, U_SHORT bin_item_index)
+void SLOBReader::decompress(std::string_view content, std::string &out) const
+{
+    if (m_codec) {
+        m_codec->decompress(content, out);
+    } else {
+        out.assign(content);
+        SLOB_COUNT(COMPRESSED_BYTES_NONE, content.size());
+        SLOB_COUNT(DECOMPRESSED_BYTES_NONE, content.size());
+    }
+}
+
+std::string SLOBReader::item(U_INT bin_index, U_SHORT bin_item_index) const
 {
-    if (bin_index >= m_store_item_positions.size())
+    if (bin_index >= m_store_item_count)
         throw std::runtime_error("SLOB: SLOBReader::item() Bin index out of bounds");
 
-    m_fp.seekg(m_store_items_data_offset + m_store_item_positions[bin_index]);
+    if (m_codec && !m_bin_cache.admit(bin_index))
+        return partial_item(bin_index, bin_item_index);
 
-    SLOBStoreItem store_item;
+    return std::string(item_view(bin_index, bin_item_index).content);
+}
 
-    U_INT bin_item_count = read_int();
-    char packed_content_type_ids[bin_item_count];
-    m_fp.read(packed_content_type_ids, bin_item_count);
+SLOBItemView SLOBReader::item_view(U_INT bin_index, U_SHORT bin_item_index) const
+{
+    if (bin_index >= m_store_item_count)
+        throw std::runtime_error("SLOB: SLOBReader::item_view() Bin index out of bounds");
 
-    for (unsigned int i = 0; i < bin_item_count; i++)
-        store_item.content_type_ids.push_back(packed_content_type_ids[i]);
+    std::shared_ptr<const SLOBStoreItem> store_item = cached_store_item(bin_index);
 
-    U_INT content_length = read_int();
+    SLOBStorageBin storage_bin(*store_item, store_item->content_type_ids.size());
+    std::string_view content = storage_bin.item(bin_item_index);
 
-    store_item.content.resize(content_length);
-    m_fp.read(&store_item.content[0], content_length);
+    return { store_item, content, content_type(store_item->content_type_ids[bin_item_index]) };
+}
 
-    if (decompress)
-        store_item.content = decompress(store_item.content);
+std::string SLOBReader::partial_item(U_INT bin_index, U_SHORT bin_item_index) const
+{
+    thread_local std::string compressed;
+    thread_local SLOBStoreItem store_item;
+
+    std::string_view content = read_store_item(bin_index, store_item, compressed);
+    U_INT bin_item_count = store_item.content_type_ids.size();
+    if (bin_item_index >= bin_item_count)
+        throw std::runtime_error("SLOB: SLOBReader::item() Item index out of bounds");
+
+    // The decompressed bin starts with the item positions, followed
+    // by the items, so stop once the requested item is complete.
+    size_t positions_size = (size_t)bin_item_count * U_INT_SIZE;
+    auto read_be = [](std::string_view data, size_t offset) {
+        U_INT value;
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        return little_endian() ? swap_endian(value) : value;
+    };
+    decompress_limit limit = [&](std::string_view out) -> size_t {
+        if (out.size() < positions_size)
+            return positions_size;
+        size_t item_offset = positions_size + read_be(out, bin_item_index * U_INT_SIZE);
+        if (out.size() < item_offset + U_INT_SIZE)
+            return item_offset + U_INT_SIZE;
+        return item_offset + U_INT_SIZE + read_be(out, item_offset);
+    };
+
+    m_codec->decompress(content, store_item.content, &limit);
 
     SLOBStorageBin storage_bin(store_item, bin_item_count);
+    return std::string(storage_bin.item(bin_item_index));
+}
 
-    return storage_bin.item(bin_item_index);
+std::vector<std::string> SLOBReader::items(std::span<const SLOBReference> refs,
+                                           SLOBThreadPool *pool) const
+{
+    std::vector<std::string> results(refs.size());
+
+    // Group requests by bin, keeping the caller's order
+    // within each bin.
+    std::vector<size_t> order(refs.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&refs](size_t a, size_t b) {
+        return refs[a].bin_index < refs[b].bin_index;
+    });
+
+    auto read_bin = [&](size_t begin, size_t end) {
+        U_INT bin_index = refs[order[begin]].bin_index;
+        if (bin_index >= m_store_item_count)
+            throw std::runtime_error("SLOB: SLOBReader::items() Bin index out of bounds");
+
+        std::shared_ptr<const SLOBStoreItem> store_item = cached_store_item(bin_index);
+        SLOBStorageBin storage_bin(*store_item, store_item->content_type_ids.size());
+        for (size_t i = begin; i < end; i++)
+            results[order[i]].assign(storage_bin.item(refs[order[i]].item_index));
+    };
+
+    std::vector<std::future<void>> pending;
+    for (size_t begin = 0, end; begin < order.size(); begin = end) {
+        for (end = begin + 1; end < order.size(); end++)
+            if (refs[order[end]].bin_index != refs[order[begin]].bin_index)
+                break;
+
+        if (pool)
+            pending.push_back(pool->async([=, &read_bin]() { read_bin(begin, end); }));
+        else
+            read_bin(begin, end);
+    }
+
+    // Wait for every bin before rethrowing the first error,
+    // as the tasks write into results.
+    for (std::future<void> &bin : pending)
+        bin.wait();
+    for (std::future<void> &bin : pending)
+        bin.get();
+
+    return results;
+}
+
+void SLOBReader::for_each_bin(const std::function<bool(U_INT, std::shared_ptr<const SLOBStoreItem>)> &call,
+                              SLOBThreadPool &pool, DELIVERY::ORDER order, size_t window) const
+{
+    if (window == 0)
+        window = DEFAULT_BIN_WINDOW_PER_THREAD * pool.size();
+
+    struct Completed {
+        std::shared_ptr<const SLOBStoreItem> store_item;
+        std::exception_ptr error;
+    };
+
+    // Bins decompressed but not yet delivered. In order, this
+    // is the reorder buffer; it never holds more than window
+    // bins, as only that many are in flight.
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::map<U_INT, Completed> completed;
+
+    U_INT next_bin = 0, next_delivery = 0;
+    size_t in_flight = 0;
+    bool stop = false;
+    std::exception_ptr error;
+
+    while (true) {
+        while (!stop && next_bin < m_store_item_count && in_flight < window) {
+            U_INT bin_index = next_bin++;
+            in_flight++;
+            pool.submit([&, bin_index]() {
+                Completed result;
+                try {
+                    result.store_item = std::make_shared<const SLOBStoreItem>(store_item(bin_index));
+                } catch (...) {
+                    result.error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                completed.emplace(bin_index, std::move(result));
+                condition.notify_one();
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stop) {
+            // Wait out the tasks still in flight,
+            // which reference this frame.
+            condition.wait(lock, [&]() { return completed.size() == in_flight; });
+            break;
+        }
+        if (in_flight == 0)
+            break;
+
+        auto ready = [&]() {
+            if (order == DELIVERY::ORDERED)
+                return completed.count(next_delivery) > 0;
+            return !completed.empty();
+        };
+        condition.wait(lock, ready);
+
+        auto it = order == DELIVERY::ORDERED ? completed.find(next_delivery) : completed.begin();
+        U_INT bin_index = it->first;
+        Completed result = std::move(it->second);
+        completed.erase(it);
+        in_flight--;
+        next_delivery++;
+        lock.unlock();
+
+        if (result.error) {
+            error = result.error;
+            stop = true;
+        } else {
+            try {
+                stop = call(bin_index, std::move(result.store_item));
+            } catch (...) {
+                error = std::current_exception();
+                stop = true;
+            }
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::shared_ptr<const SLOBStoreItem> SLOBReader::cached_store_item(U_INT bin_index) const
+{
+    if (m_bin_cache.budget() == 0)
+        return std::make_shared<const SLOBStoreItem>(store_item(bin_index));
+
+    std::shared_ptr<const SLOBStoreItem> item = m_bin_cache.get(bin_index);
+    if (item)
+        return item;
+
+    item = std::make_shared<const SLOBStoreItem>(store_item(bin_index));
+    m_bin_cache.put(bin_index, item);
+    return item;
 }
@@ -0,0 +1,188 @@
+#include "slob_file.h"
+#include "metrics.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SLOBFile::SLOBFile()
+{
+}
+
+SLOBFile::~SLOBFile()
+{
+    close();
+}
+
+void SLOBFile::open(const char *filename, BACKEND::TYPE backend)
+{
+    close();
+
+    int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::invalid_argument("SLOB: Could not open SLOB file");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("SLOB: Could not stat SLOB file");
+    }
+    m_size = st.st_size;
+
+    if (backend == BACKEND::STREAM) {
+        m_fd = fd;
+        return;
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        throw std::runtime_error("SLOB: Could not map SLOB file");
+    }
+    m_data = static_cast<const char *>(data);
+}
+
+void SLOBFile::close()
+{
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_data = nullptr;
+    m_fd = -1;
+    m_size = 0;
+}
+
+void SLOBFile::check_range(uint64_t offset, size_t length) const
+{
+    if (offset > m_size || length > m_size - offset)
+        throw std::runtime_error("SLOB: Read past the end of the SLOB file");
+}
+
+void SLOBFile::read(uint64_t offset, char *buffer, size_t length) const
+{
+    check_range(offset, length);
+
+    if (m_data) {
+        std::memcpy(buffer, m_data + offset, length);
+        SLOB_COUNT(BYTES_MAPPED, length);
+        return;
+    }
+
+    SLOB_TIME(FILE_READ);
+    SLOB_COUNT(FILE_READS, 1);
+    SLOB_COUNT(BYTES_READ, length);
+    while (length > 0) {
+        ssize_t count = pread(m_fd, buffer, length, offset);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            throw std::runtime_error("SLOB: Could not read from SLOB file");
+        buffer += count;
+        offset += count;
+        length -= count;
+    }
+}
+
+std::string_view SLOBFile::view(uint64_t offset, size_t length) const
+{
+    if (!m_data)
+        throw std::runtime_error("SLOB: SLOBFile::view() requires a mapped file");
+
+    check_range(offset, length);
+    SLOB_COUNT(BYTES_MAPPED, length);
+    return std::string_view(m_data + offset, length);
+}
+
+void SLOBFile::advise(ACCESS::PATTERN pattern, uint64_t offset, size_t length) const
+{
+    if (!m_data)
+        return;
+
+    check_range(offset, length);
+    if (length == 0)
+        length = m_size - offset;
+
+    // madvise() needs a page aligned address.
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t aligned = offset - offset % page_size;
+    length += offset - aligned;
+
+    int advice = MADV_NORMAL;
+    switch (pattern) {
+    case ACCESS::SEQUENTIAL:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case ACCESS::RANDOM:
+        advice = MADV_RANDOM;
+        break;
+    default:
+        break;
+    }
+
+    madvise(const_cast<char *>(m_data) + aligned, length, advice);
+}
+
+SLOBCursor::SLOBCursor(const SLOBFile &file, uint64_t offset, size_t buffer_size)
+    : m_file(file), m_offset(offset), m_buffer_size(buffer_size)
+{
+}
+
+bool SLOBCursor::buffered(size_t length) const
+{
+    return m_offset >= m_buffer_offset &&
+        m_offset + length <= m_buffer_offset + m_buffer.size();
+}
+
+void SLOBCursor::fill(size_t length)
+{
+    if (m_offset > m_file.size())
+        throw std::runtime_error("SLOB: Read past the end of the SLOB file");
+
+    size_t ahead = std::min<uint64_t>(std::max(length, m_buffer_size), m_file.size() - m_offset);
+    m_buffer.resize(ahead);
+    m_buffer_offset = m_offset;
+    m_file.read(m_offset, &m_buffer[0], ahead);
+}
+
+void SLOBCursor::read(char *buffer, size_t length)
+{
+    if (m_file.mapped()) {
+        m_file.read(m_offset, buffer, length);
+        m_offset += length;
+        return;
+    }
+
+    // Large reads bypass the read-ahead buffer.
+    if (!buffered(length) && length >= m_buffer_size) {
+        m_file.read(m_offset, buffer, length);
+        m_offset += length;
+        return;
+    }
+
+    std::memcpy(buffer, view(length).data(), length);
+}
+
+std::string_view SLOBCursor::view(size_t length)
+{
+    if (m_file.mapped()) {
+        std::string_view bytes = m_file.view(m_offset, length);
+        m_offset += length;
+        return bytes;
+    }
+
+    if (!buffered(length))
+        fill(length);
+    if (!buffered(length))
+        throw std::runtime_error("SLOB: Read past the end of the SLOB file");
+
+    std::string_view bytes(m_buffer.data() + (m_offset - m_buffer_offset), length);
+    m_offset += length;
+    return bytes;
+}
@@ -0,0 +1,338 @@
+#include "slob_writer.h"
+#include "collator.h"
+#include <cstdio>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <unicode/unistr.h>
+
+// References whose sort keys one pool task computes.
+#define SORT_KEYS_PER_TASK 4096
+// Initial sort key buffer, grown for longer keys.
+#define SORT_KEY_BUFFER_LEN 64
+
+// Big-endian encoding of SLOB numbers.
+template <typename T>
+static void append_number(std::string &out, T value)
+{
+    for (int i = sizeof(T) - 1; i >= 0; i--)
+        out.push_back(value >> (8 * i));
+}
+
+template <typename LenSpec>
+static void append_text(std::string &out, std::string_view text, size_t pad = 0)
+{
+    if (text.size() > calcmax(LenSpec))
+        throw std::invalid_argument("SLOB: Text too long");
+    size_t length = std::max(text.size(), pad);
+    append_number<LenSpec>(out, length);
+    out.append(text);
+    out.append(length - text.size(), '\0');
+}
+
+static std::string random_uuid()
+{
+    std::random_device random;
+    std::string uuid(16, '\0');
+    for (char &byte : uuid)
+        byte = random();
+    // Version 4 (random), variant 1.
+    uuid[6] = (uuid[6] & 0x0f) | 0x40;
+    uuid[8] = (uuid[8] & 0x3f) | 0x80;
+    return uuid;
+}
+
+// Serialize and compress a bin into its store record: item count,
+// content type ids, then the compressed item positions and items.
+static std::string pack_bin(const std::vector<U_CHAR> &content_type_ids,
+                            const std::vector<std::string> &items, const SLOBCodec *codec)
+{
+    std::string content;
+    U_INT position = 0;
+    for (const std::string &item : items) {
+        append_number<U_INT>(content, position);
+        position += U_INT_SIZE + item.size();
+    }
+    for (const std::string &item : items) {
+        append_number<U_INT>(content, item.size());
+        content.append(item);
+    }
+
+    std::string compressed;
+    if (codec)
+        codec->compress(content, compressed);
+    else
+        compressed = std::move(content);
+
+    std::string record;
+    record.reserve(U_INT_SIZE * 2 + items.size() + compressed.size());
+    append_number<U_INT>(record, items.size());
+    record.append(content_type_ids.begin(), content_type_ids.end());
+    append_number<U_INT>(record, compressed.size());
+    record.append(compressed);
+    return record;
+}
+
+SLOBWriter::SLOBWriter(const char *path, const std::string &compression, SLOBThreadPool *pool)
+    : m_path(path), m_temp_path(std::string(path) + ".tmp"),
+      m_store_path(std::string(path) + ".store.tmp"), m_compression(compression),
+      m_uuid(random_uuid()), m_pool(pool)
+{
+    if (!m_compression.empty()) {
+        auto codec = COMPRESSION.find(m_compression);
+        if (codec == COMPRESSION.end())
+            throw std::invalid_argument("SLOB: Compression unsupported");
+        m_codec = codec->second;
+    }
+
+    m_store.open(m_store_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_store)
+        throw std::invalid_argument("SLOB: Could not create store file");
+}
+
+SLOBWriter::~SLOBWriter()
+{
+    if (!m_finalized) {
+        m_store.close();
+        std::remove(m_store_path.c_str());
+        std::remove(m_temp_path.c_str());
+    }
+}
+
+void SLOBWriter::set_bin_item_count(U_INT count)
+{
+    if (count == 0 || count > MAX_BIN_ITEM_COUNT)
+        throw std::invalid_argument("SLOB: Bin item count out of range");
+    m_bin_item_count = count;
+}
+
+void SLOBWriter::set_bin_size(size_t size)
+{
+    m_bin_size = size;
+}
+
+void SLOBWriter::set_uuid(std::string_view uuid)
+{
+    if (uuid.size() != 16)
+        throw std::invalid_argument("SLOB: UUID must be 16 bytes");
+    m_uuid = uuid;
+}
+
+void SLOBWriter::tag(const std::string &name, const std::string &value)
+{
+    if (name.size() > MAX_TINY_TEXT_LEN || value.size() > MAX_TINY_TEXT_LEN)
+        throw std::invalid_argument("SLOB: Tag too long");
+
+    for (auto &tag : m_tags) {
+        if (tag.first == name) {
+            tag.second = value;
+            return;
+        }
+    }
+    if (m_tags.size() == MAX_TINY_TEXT_LEN)
+        throw std::invalid_argument("SLOB: Too many tags");
+    m_tags.emplace_back(name, value);
+}
+
+U_INT SLOBWriter::add_item(std::string_view content, const std::string &content_type)
+{
+    if (m_finalized)
+        throw std::logic_error("SLOB: Writer is finalized");
+    if (content.size() > MAX_LARGE_BYTE_STRING_LEN)
+        throw std::invalid_argument("SLOB: Item too large");
+    if (m_item_bins.size() == MAX_LARGE_BYTE_STRING_LEN)
+        throw std::invalid_argument("SLOB: Too many items");
+
+    auto id = m_content_type_ids.find(content_type);
+    if (id == m_content_type_ids.end()) {
+        if (content_type.size() > MAX_TEXT_LEN)
+            throw std::invalid_argument("SLOB: Content type too long");
+        if (m_content_types.size() == MAX_TINY_TEXT_LEN)
+            throw std::invalid_argument("SLOB: Too many content types");
+        id = m_content_type_ids.emplace(content_type, m_content_types.size()).first;
+        m_content_types.push_back(content_type);
+    }
+
+    m_item_bins.push_back(m_bin_count);
+    m_item_indexes.push_back(m_bin.items.size());
+    m_bin.content_type_ids.push_back(id->second);
+    m_bin.items.emplace_back(content);
+    m_bin.size += content.size();
+
+    if (m_bin.items.size() >= m_bin_item_count || m_bin.size >= m_bin_size)
+        close_bin();
+
+    return m_item_bins.size() - 1;
+}
+
+void SLOBWriter::add_reference(std::string_view key, U_INT item, std::string_view fragment)
+{
+    if (m_finalized)
+        throw std::logic_error("SLOB: Writer is finalized");
+    if (item >= m_item_bins.size())
+        throw std::out_of_range("SLOB: Reference to unknown item");
+    if (key.size() > MAX_TEXT_LEN)
+        throw std::invalid_argument("SLOB: Key too long");
+    if (fragment.size() > MAX_TINY_TEXT_LEN)
+        throw std::invalid_argument("SLOB: Fragment too long");
+    if (m_references.size() == MAX_LARGE_BYTE_STRING_LEN)
+        throw std::invalid_argument("SLOB: Too many references");
+
+    m_references.push_back(key, m_item_bins[item], m_item_indexes[item], fragment);
+}
+
+void SLOBWriter::close_bin()
+{
+    Bin bin = std::move(m_bin);
+    m_bin = Bin();
+    m_bin_count++;
+
+    if (!m_pool) {
+        write_bin(pack_bin(bin.content_type_ids, bin.items, m_codec));
+        return;
+    }
+
+    const SLOBCodec *codec = m_codec;
+    m_pending.push_back(m_pool->async([bin = std::move(bin), codec]() {
+        return pack_bin(bin.content_type_ids, bin.items, codec);
+    }));
+
+    size_t window = m_pool->size() * DEFAULT_BIN_WINDOW_PER_THREAD;
+    while (m_pending.size() > window) {
+        std::string record = m_pending.front().get();
+        m_pending.pop_front();
+        write_bin(record);
+    }
+}
+
+void SLOBWriter::write_bin(std::string_view record)
+{
+    m_store_positions.push_back(m_store_size);
+    m_store.write(record.data(), record.size());
+    m_store_size += record.size();
+}
+
+std::vector<U_INT> SLOBWriter::sort_references() const
+{
+    std::vector<std::string> sortkeys(m_references.size());
+    auto compute = [&](size_t begin, size_t end) {
+        const Collator &collator = SLOBCollator::sorting();
+        for (size_t i = begin; i < end; i++) {
+            std::string_view key = m_references[i].key;
+            UnicodeString ukey = UnicodeString::fromUTF8(StringPiece(key.data(), key.size()));
+            std::string &sortkey = sortkeys[i];
+            sortkey.resize(SORT_KEY_BUFFER_LEN);
+            int32_t length = collator.getSortKey(ukey, reinterpret_cast<uint8_t *>(sortkey.data()),
+                                                 sortkey.size());
+            if (length > (int32_t)sortkey.size()) {
+                sortkey.resize(length);
+                collator.getSortKey(ukey, reinterpret_cast<uint8_t *>(sortkey.data()), length);
+            }
+            sortkey.resize(length);
+        }
+    };
+
+    if (m_pool) {
+        std::vector<std::future<void>> tasks;
+        for (size_t begin = 0; begin < sortkeys.size(); begin += SORT_KEYS_PER_TASK) {
+            size_t end = std::min(begin + SORT_KEYS_PER_TASK, sortkeys.size());
+            tasks.push_back(m_pool->async([&compute, begin, end]() { compute(begin, end); }));
+        }
+        for (auto &task : tasks)
+            task.wait();
+        for (auto &task : tasks)
+            task.get();
+    } else {
+        compute(0, sortkeys.size());
+    }
+
+    std::vector<U_INT> order(m_references.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](U_INT a, U_INT b) {
+        return sortkeys[a] < sortkeys[b];
+    });
+    return order;
+}
+
+void SLOBWriter::finalize()
+{
+    if (m_finalized)
+        throw std::logic_error("SLOB: Writer is finalized");
+
+    if (!m_bin.items.empty())
+        close_bin();
+    while (!m_pending.empty()) {
+        std::string record = m_pending.front().get();
+        m_pending.pop_front();
+        write_bin(record);
+    }
+    m_store.close();
+    if (!m_store)
+        throw std::runtime_error("SLOB: Could not write store file");
+
+    std::vector<U_INT> order = sort_references();
+
+    std::string refs;
+    append_number<U_INT>(refs, order.size());
+    U_LONG_LONG position = 0;
+    for (U_INT i : order) {
+        SLOBReferenceView ref = m_references[i];
+        append_number<U_LONG_LONG>(refs, position);
+        position += U_SHORT_SIZE + ref.key.size() + U_INT_SIZE + U_SHORT_SIZE +
+                    U_CHAR_SIZE + ref.fragment.size();
+    }
+    for (U_INT i : order) {
+        SLOBReferenceView ref = m_references[i];
+        append_text<U_SHORT>(refs, ref.key);
+        append_number<U_INT>(refs, ref.bin_index);
+        append_number<U_SHORT>(refs, ref.item_index);
+        append_text<U_CHAR>(refs, ref.fragment);
+    }
+
+    std::string header(MAGIC);
+    header.append(m_uuid);
+    append_text<U_CHAR>(header, UTF8);
+    append_text<U_CHAR>(header, m_compression);
+    append_number<U_CHAR>(header, m_tags.size());
+    for (const auto &tag : m_tags) {
+        append_text<U_CHAR>(header, tag.first);
+        // Values are padded, so they can be edited in place.
+        append_text<U_CHAR>(header, tag.second, MAX_TINY_TEXT_LEN);
+    }
+    append_number<U_CHAR>(header, m_content_types.size());
+    for (const std::string &content_type : m_content_types)
+        append_text<U_SHORT>(header, content_type);
+    append_number<U_INT>(header, m_item_bins.size());
+
+    U_LONG_LONG store_offset = header.size() + 2 * U_LONG_LONG_SIZE + refs.size();
+    U_LONG_LONG size = store_offset + U_INT_SIZE +
+                       (U_LONG_LONG)m_store_positions.size() * U_LONG_LONG_SIZE + m_store_size;
+    append_number<U_LONG_LONG>(header, store_offset);
+    append_number<U_LONG_LONG>(header, size);
+
+    std::string store;
+    append_number<U_INT>(store, m_store_positions.size());
+    for (U_LONG_LONG store_position : m_store_positions)
+        append_number<U_LONG_LONG>(store, store_position);
+
+    std::ofstream out(m_temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::invalid_argument("SLOB: Could not create SLOB file");
+    out.write(header.data(), header.size());
+    out.write(refs.data(), refs.size());
+    out.write(store.data(), store.size());
+
+    std::ifstream in(m_store_path, std::ios::in | std::ios::binary);
+    if (m_store_size && !(out << in.rdbuf()))
+        throw std::runtime_error("SLOB: Could not copy store file");
+    in.close();
+    out.close();
+    if (!out)
+        throw std::runtime_error("SLOB: Could not write SLOB file");
+
+    if (std::rename(m_temp_path.c_str(), m_path.c_str()) != 0)
+        throw std::runtime_error("SLOB: Could not rename SLOB file");
+    std::remove(m_store_path.c_str());
+    m_finalized = true;
+}
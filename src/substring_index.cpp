@@ -0,0 +1,117 @@
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <unicode/utf8.h>
+#include "substring_index.h"
+
+void SLOBSubstringIndex::build(const SLOBReader &reader, const char *path)
+{
+    SLOBFoldedKeyTable table;
+    table.build(reader);
+
+    // Suffixes start at code point boundaries, and end with their key.
+    std::vector<std::pair<U_INT, U_INT>> suffixes;
+    std::string_view keys = table.keys();
+    for (U_INT index = 0; index < table.size(); index++) {
+        std::string_view key = table.key(index);
+        U_INT begin = key.data() - keys.data();
+        for (U_INT offset = 0; offset < key.size(); offset++)
+            if (!U8_IS_TRAIL(key[offset]))
+                suffixes.emplace_back(begin + offset, begin + key.size());
+    }
+    std::sort(suffixes.begin(), suffixes.end(), [&](const auto &a, const auto &b) {
+        std::string_view x = keys.substr(a.first, a.second - a.first);
+        std::string_view y = keys.substr(b.first, b.second - b.first);
+        return x < y || (x == y && a.first < b.first);
+    });
+
+    SLOBSidecarWriter writer(path, SUBSTRING_INDEX_MAGIC, reader);
+    table.write(writer);
+    writer.write_int(suffixes.size());
+    for (const auto &suffix : suffixes)
+        writer.write_int(suffix.first);
+    writer.commit();
+}
+
+void SLOBSubstringIndex::open(const char *path, const SLOBReader &reader)
+{
+    // Opening unmaps the previous index, so a failed
+    // open must not leave the tables viewing it.
+    m_open = false;
+    m_table = SLOBFoldedKeyTable();
+    m_suffix_count = 0;
+    m_suffixes = nullptr;
+    m_sidecar.open(path, SUBSTRING_INDEX_MAGIC, reader);
+    std::string_view data = m_sidecar.data();
+
+    size_t table_size = m_table.view(data, reader);
+    data.remove_prefix(table_size);
+    if (data.size() < U_INT_SIZE)
+        throw std::runtime_error("SLOB: Substring index is truncated");
+
+    U_INT suffix_count = load_int(data.data());
+    if (data.size() - U_INT_SIZE < (size_t)suffix_count * U_INT_SIZE
+            || suffix_count > m_table.keys().size())
+        throw std::runtime_error("SLOB: Substring index is corrupt");
+
+    m_suffix_count = suffix_count;
+    m_suffixes = data.data() + U_INT_SIZE;
+    m_open = true;
+}
+
+std::string_view SLOBSubstringIndex::suffix(U_INT index) const
+{
+    U_INT offset = load_int(m_suffixes + (size_t)index * U_INT_SIZE);
+    if (offset >= m_table.keys().size())
+        throw std::runtime_error("SLOB: Substring index is corrupt");
+
+    std::string_view key = m_table.key(m_table.key_at(offset));
+    return key.substr(offset - (key.data() - m_table.keys().data()));
+}
+
+std::vector<U_INT> SLOBSubstringIndex::search(std::string_view term, size_t limit) const
+{
+    if (!m_open)
+        throw std::runtime_error("SLOB: Substring index is not open");
+
+    std::string folded = fold_key(term);
+    if (folded.empty())
+        return {};
+
+    // Suffixes starting with the term form one run.
+    U_INT low = 0, high = m_suffix_count;
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        if (suffix(middle) < folded)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    U_INT begin = low;
+    high = m_suffix_count;
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        if (suffix(middle).starts_with(folded))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // A key matches once per occurrence of the term.
+    std::vector<U_INT> keys;
+    keys.reserve(low - begin);
+    for (U_INT i = begin; i < low; i++)
+        keys.push_back(m_table.key_at(load_int(m_suffixes + (size_t)i * U_INT_SIZE)));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (limit > 0 && keys.size() > limit)
+        keys.resize(limit);
+
+    std::vector<U_INT> references;
+    for (U_INT key : keys) {
+        auto [first, last] = m_table.references(key);
+        for (U_INT slot = first; slot < last; slot++)
+            references.push_back(m_table.reference(slot));
+    }
+    return references;
+}
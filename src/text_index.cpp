@@ -0,0 +1,594 @@
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <cctype>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unicode/utf8.h>
+#include <unicode/uchar.h>
+#include "folding.h"
+#include "text_index.h"
+
+// Payload: document count, term count, total document length,
+// documents (bin index, item index, length), term offsets and
+// posting offsets (term count + 1 each), document frequencies,
+// term bytes and postings.
+#define TEXT_INDEX_HEADER_SIZE (2 * U_INT_SIZE + U_LONG_LONG_SIZE)
+#define TEXT_INDEX_DOCUMENT_SIZE (2 * U_INT_SIZE + U_SHORT_SIZE)
+
+static bool is_word_char(UChar32 c)
+{
+    return u_isalnum(c) || u_charType(c) == U_NON_SPACING_MARK;
+}
+
+// Skip an HTML tag, or the whole element for scripts and styles.
+static size_t skip_tag(std::string_view content, size_t pos)
+{
+    size_t end = content.find('>', pos);
+    if (end == std::string_view::npos)
+        return content.size();
+
+    for (std::string_view element : { "script", "style" }) {
+        if (content.size() - pos > element.size()
+                && content.compare(pos + 1, element.size(), element) == 0) {
+            std::string closing = "</" + std::string(element);
+            size_t close = content.find(closing, end);
+            if (close == std::string_view::npos)
+                return content.size();
+            end = content.find('>', close);
+            return end == std::string_view::npos ? content.size() : end + 1;
+        }
+    }
+    return end + 1;
+}
+
+// Call with every folded word of a text or HTML content.
+template<typename C>
+static void tokenize(std::string_view content, bool html, C call)
+{
+    const char *bytes = content.data();
+    int32_t length = content.size();
+
+    int32_t pos = 0, word = -1;
+    auto flush = [&](int32_t end) {
+        if (word >= 0 && end - word <= TEXT_INDEX_MAX_TOKEN_LEN) {
+            std::string_view token = content.substr(word, end - word);
+            bool ascii = std::all_of(token.begin(), token.end(), [](char c) {
+                return (unsigned char)c < 0x80;
+            });
+            if (ascii) {
+                std::string lower(token);
+                for (char &c : lower)
+                    c = std::tolower((unsigned char)c);
+                call(lower);
+            } else {
+                std::string folded = fold_key(token);
+                if (!folded.empty())
+                    call(folded);
+            }
+        }
+        word = -1;
+    };
+
+    while (pos < length) {
+        if (html && (bytes[pos] == '<' || bytes[pos] == '&')) {
+            flush(pos);
+            if (bytes[pos] == '<') {
+                pos = skip_tag(content, pos);
+            } else {
+                // Entities separate words.
+                size_t end = content.find(';', pos);
+                pos = end != std::string_view::npos && end - pos <= 10 ? end + 1 : pos + 1;
+            }
+            continue;
+        }
+
+        int32_t start = pos;
+        UChar32 c;
+        U8_NEXT(bytes, pos, length, c);
+        if (c >= 0 && is_word_char(c)) {
+            if (word < 0)
+                word = start;
+        } else {
+            flush(start);
+        }
+    }
+    flush(length);
+}
+
+static bool is_text(const std::string &content_type, bool &html)
+{
+    html = content_type.starts_with(MIME_HTML);
+    for (const auto &type : MIME_TYPES)
+        if (content_type.starts_with(type.second))
+            return true;
+    return false;
+}
+
+namespace {
+
+struct Document {
+    U_INT bin_index;
+    U_SHORT item_index;
+    U_INT length;
+};
+
+// Postings of a term: documents, in order, and the
+// term's frequency in each.
+typedef std::vector<std::pair<U_INT, U_INT>> PostingList;
+
+// Documents and postings of a run of bins, numbered
+// from the run's first document.
+struct PartialIndex {
+    std::vector<Document> documents;
+    std::unordered_map<std::string, PostingList> postings;
+};
+
+}
+
+static PartialIndex index_bins(const SLOBReader &reader, U_INT begin, U_INT end)
+{
+    PartialIndex partial;
+    std::unordered_map<std::string, U_INT> frequencies;
+
+    for (U_INT bin = begin; bin < end; bin++) {
+        SLOBStoreItem store_item = reader.store_item(bin);
+        U_INT bin_item_count = store_item.content_type_ids.size();
+        SLOBStorageBin storage_bin(store_item, bin_item_count);
+
+        for (U_INT i = 0; i < bin_item_count; i++) {
+            std::string_view content = storage_bin.next();
+            bool html;
+            if (!is_text(reader.content_type(store_item.content_type_ids[i]), html))
+                continue;
+
+            U_INT length = 0;
+            frequencies.clear();
+            tokenize(content, html, [&](std::string_view token) {
+                frequencies[std::string(token)]++;
+                length++;
+            });
+
+            U_INT document = partial.documents.size();
+            partial.documents.push_back({ bin, (U_SHORT)i, length });
+            for (const auto &[token, frequency] : frequencies)
+                partial.postings[token].emplace_back(document, frequency);
+        }
+    }
+    return partial;
+}
+
+// Postings map entry bookkeeping, in bytes, counted
+// against the build's memory budget.
+#define POSTING_LIST_OVERHEAD 96
+// Bytes buffered before writes to run and postings files.
+#define TEXT_INDEX_WRITE_BUFFER_SIZE (1 << 20)
+
+// Removes a build's scratch files, however it ends.
+struct ScratchFiles {
+    ~ScratchFiles()
+    {
+        for (const std::string &path : paths)
+            std::remove(path.c_str());
+    }
+
+    std::vector<std::string> paths;
+};
+
+static void write_buffer(std::ofstream &out, std::string &buffer)
+{
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+// Write postings to a run file and clear them. Terms come in order,
+// each with its length, bytes, posting count and delta-encoded
+// postings.
+static void write_run(const std::string &path, std::unordered_map<std::string, PostingList> &postings)
+{
+    std::vector<const std::string *> terms;
+    terms.reserve(postings.size());
+    for (const auto &entry : postings)
+        terms.push_back(&entry.first);
+    std::sort(terms.begin(), terms.end(), [](const std::string *a, const std::string *b) {
+        return *a < *b;
+    });
+
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("SLOB: Could not create text index run file");
+
+    std::string buffer;
+    for (const std::string *term : terms) {
+        const PostingList &list = postings[*term];
+        append_varint(buffer, term->size());
+        buffer.append(*term);
+        append_varint(buffer, list.size());
+        U_INT previous = 0;
+        for (const auto &[document, frequency] : list) {
+            append_varint(buffer, document - previous);
+            append_varint(buffer, frequency);
+            previous = document;
+        }
+        if (buffer.size() >= TEXT_INDEX_WRITE_BUFFER_SIZE)
+            write_buffer(out, buffer);
+    }
+    write_buffer(out, buffer);
+    out.close();
+    if (!out)
+        throw std::runtime_error("SLOB: Could not write text index run file");
+    postings.clear();
+}
+
+namespace {
+
+// Reads the terms of a run file in order.
+class RunReader {
+public:
+    RunReader(const std::string &path)
+        : m_in(path, std::ios::in | std::ios::binary)
+    {
+        if (!m_in)
+            throw std::runtime_error("SLOB: Could not open text index run file");
+        next();
+    }
+
+    bool done() const { return m_done; }
+    const std::string &term() const { return m_term; }
+
+    // Call with every posting of the current term,
+    // and move to the next term.
+    template<typename C>
+    void postings(C call)
+    {
+        U_INT document = 0;
+        for (U_LONG_LONG i = 0; i < m_count; i++) {
+            document += varint();
+            call(document, (U_INT)varint());
+        }
+        next();
+    }
+
+private:
+    void next()
+    {
+        if (m_in.peek() == std::ifstream::traits_type::eof()) {
+            m_done = true;
+            return;
+        }
+        m_term.resize(varint());
+        if (!m_in.read(m_term.data(), m_term.size()))
+            throw std::runtime_error("SLOB: Text index run file is truncated");
+        m_count = varint();
+    }
+
+    U_LONG_LONG varint()
+    {
+        U_LONG_LONG value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = m_in.get();
+            if (byte == std::ifstream::traits_type::eof())
+                break;
+            value |= (U_LONG_LONG)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("SLOB: Text index run file is truncated");
+    }
+
+    std::ifstream m_in;
+    std::string m_term;
+    U_LONG_LONG m_count { 0 };
+    bool m_done { false };
+};
+
+}
+
+void SLOBTextIndex::build(const SLOBReader &reader, const char *path, SLOBThreadPool *pool,
+                          size_t memory)
+{
+    std::vector<Document> documents;
+    std::unordered_map<std::string, PostingList> postings;
+    size_t postings_bytes = 0;
+
+    ScratchFiles scratch;
+    std::vector<std::string> runs;
+    auto spill = [&]() {
+        std::string run_path = std::string(path) + ".run" + std::to_string(runs.size());
+        scratch.paths.push_back(run_path);
+        write_run(run_path, postings);
+        runs.push_back(run_path);
+        postings_bytes = 0;
+    };
+
+    auto merge = [&](PartialIndex partial) {
+        U_INT first = documents.size();
+        documents.insert(documents.end(), partial.documents.begin(), partial.documents.end());
+        for (auto &[token, list] : partial.postings) {
+            auto [merged, inserted] = postings.try_emplace(token);
+            if (inserted)
+                postings_bytes += token.size() + POSTING_LIST_OVERHEAD;
+            for (const auto &[document, frequency] : list)
+                merged->second.emplace_back(first + document, frequency);
+            postings_bytes += list.size() * sizeof(PostingList::value_type);
+        }
+        if (postings_bytes > memory)
+            spill();
+    };
+
+    // Runs of bins are tokenized in parallel, and merged in
+    // order so document numbers stay sorted in every list.
+    // A window of runs in flight bounds the partial indexes.
+    size_t window = pool ? DEFAULT_BIN_WINDOW_PER_THREAD * pool->size() : 0;
+    std::deque<std::future<PartialIndex>> pending;
+    try {
+        for (U_INT begin = 0; begin < reader.bin_count(); begin += TEXT_INDEX_BINS_PER_TASK) {
+            U_INT end = std::min<U_INT>(begin + TEXT_INDEX_BINS_PER_TASK, reader.bin_count());
+            if (!pool) {
+                merge(index_bins(reader, begin, end));
+                continue;
+            }
+            if (pending.size() >= window) {
+                merge(pending.front().get());
+                pending.pop_front();
+            }
+            pending.push_back(pool->async([&reader, begin, end]() {
+                return index_bins(reader, begin, end);
+            }));
+        }
+        for (; !pending.empty(); pending.pop_front())
+            merge(pending.front().get());
+    } catch (...) {
+        // Let the remaining runs finish before the
+        // caller can release the reader.
+        for (std::future<PartialIndex> &run : pending)
+            if (run.valid())
+                run.wait();
+        throw;
+    }
+    if (!postings.empty())
+        spill();
+
+    // Merge the runs term by term into the postings file. Later
+    // runs hold later documents, so the postings of a term are
+    // its postings in every run, in run order.
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (const std::string &run_path : runs)
+        readers.push_back(std::make_unique<RunReader>(run_path));
+    auto later = [&](size_t a, size_t b) {
+        int order = readers[a]->term().compare(readers[b]->term());
+        return order > 0 || (order == 0 && a > b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t run = 0; run < readers.size(); run++)
+        if (!readers[run]->done())
+            heap.push(run);
+
+    std::string postings_path = std::string(path) + ".postings";
+    scratch.paths.push_back(postings_path);
+    std::ofstream postings_out(postings_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!postings_out)
+        throw std::runtime_error("SLOB: Could not create text index postings file");
+
+    std::string term_bytes, posting_bytes;
+    U_LONG_LONG postings_size = 0;
+    std::vector<U_INT> term_offsets, document_frequencies;
+    std::vector<U_LONG_LONG> posting_offsets;
+    while (!heap.empty()) {
+        std::string term = readers[heap.top()]->term();
+        term_offsets.push_back(term_bytes.size());
+        posting_offsets.push_back(postings_size);
+        term_bytes.append(term);
+
+        U_INT count = 0, previous = 0;
+        while (!heap.empty() && readers[heap.top()]->term() == term) {
+            size_t run = heap.top();
+            heap.pop();
+            readers[run]->postings([&](U_INT document, U_INT frequency) {
+                size_t size = posting_bytes.size();
+                append_varint(posting_bytes, document - previous);
+                append_varint(posting_bytes, frequency);
+                postings_size += posting_bytes.size() - size;
+                previous = document;
+                count++;
+            });
+            if (!readers[run]->done())
+                heap.push(run);
+        }
+        document_frequencies.push_back(count);
+        if (posting_bytes.size() >= TEXT_INDEX_WRITE_BUFFER_SIZE)
+            write_buffer(postings_out, posting_bytes);
+    }
+    term_offsets.push_back(term_bytes.size());
+    posting_offsets.push_back(postings_size);
+    write_buffer(postings_out, posting_bytes);
+    postings_out.close();
+    if (!postings_out)
+        throw std::runtime_error("SLOB: Could not write text index postings file");
+
+    U_LONG_LONG total_length = 0;
+    for (const Document &document : documents)
+        total_length += document.length;
+
+    SLOBSidecarWriter writer(path, TEXT_INDEX_MAGIC, reader);
+    writer.write_int(documents.size());
+    writer.write_int(document_frequencies.size());
+    writer.write_long(total_length);
+    for (const Document &document : documents) {
+        writer.write_int(document.bin_index);
+        writer.write_byte(document.item_index);
+        writer.write_byte(document.item_index >> 8);
+        writer.write_int(document.length);
+    }
+    for (U_INT offset : term_offsets)
+        writer.write_int(offset);
+    for (U_LONG_LONG offset : posting_offsets)
+        writer.write_long(offset);
+    for (U_INT frequency : document_frequencies)
+        writer.write_int(frequency);
+    writer.write(term_bytes);
+
+    std::ifstream postings_in(postings_path, std::ios::in | std::ios::binary);
+    std::string buffer(TEXT_INDEX_WRITE_BUFFER_SIZE, '\0');
+    while (postings_in.read(buffer.data(), buffer.size()) || postings_in.gcount() > 0)
+        writer.write(std::string_view(buffer.data(), postings_in.gcount()));
+    if (postings_in.bad())
+        throw std::runtime_error("SLOB: Could not read text index postings file");
+    writer.commit();
+}
+
+void SLOBTextIndex::open(const char *path, const SLOBReader &reader)
+{
+    // Opening unmaps the previous index, so a failed
+    // open must not leave the tables viewing it.
+    m_open = false;
+    m_document_count = m_term_count = 0;
+    m_average_length = 0;
+    m_documents = m_term_offsets = m_posting_offsets = m_document_frequencies = nullptr;
+    m_terms = m_postings = std::string_view();
+    m_sidecar.open(path, TEXT_INDEX_MAGIC, reader);
+    std::string_view data = m_sidecar.data();
+    if (data.size() < TEXT_INDEX_HEADER_SIZE)
+        throw std::runtime_error("SLOB: Text index is truncated");
+
+    U_INT document_count = load_int(data.data());
+    U_INT term_count = load_int(data.data() + U_INT_SIZE);
+    U_LONG_LONG total_length = load_long(data.data() + 2 * U_INT_SIZE);
+
+    size_t documents_size = (size_t)document_count * TEXT_INDEX_DOCUMENT_SIZE;
+    size_t tables_size = documents_size + ((size_t)term_count + 1) * (U_INT_SIZE + U_LONG_LONG_SIZE)
+                         + (size_t)term_count * U_INT_SIZE;
+    if (data.size() < TEXT_INDEX_HEADER_SIZE + tables_size)
+        throw std::runtime_error("SLOB: Text index is corrupt");
+
+    m_documents = data.data() + TEXT_INDEX_HEADER_SIZE;
+    m_term_offsets = m_documents + documents_size;
+    m_posting_offsets = m_term_offsets + ((size_t)term_count + 1) * U_INT_SIZE;
+    m_document_frequencies = m_posting_offsets + ((size_t)term_count + 1) * U_LONG_LONG_SIZE;
+
+    std::string_view rest = data.substr(TEXT_INDEX_HEADER_SIZE + tables_size);
+    size_t terms_size = load_int(m_term_offsets + (size_t)term_count * U_INT_SIZE);
+    U_LONG_LONG postings_size = load_long(m_posting_offsets + (size_t)term_count * U_LONG_LONG_SIZE);
+    if (rest.size() < terms_size || rest.size() - terms_size < postings_size)
+        throw std::runtime_error("SLOB: Text index is corrupt");
+
+    m_terms = rest.substr(0, terms_size);
+    m_postings = rest.substr(terms_size, postings_size);
+    m_document_count = document_count;
+    m_term_count = term_count;
+    m_average_length = document_count > 0 ? (double)total_length / document_count : 0;
+    m_open = true;
+}
+
+std::string_view SLOBTextIndex::term(U_INT index) const
+{
+    U_INT begin = load_int(m_term_offsets + (size_t)index * U_INT_SIZE);
+    U_INT end = load_int(m_term_offsets + ((size_t)index + 1) * U_INT_SIZE);
+    if (begin > end || end > m_terms.size())
+        throw std::runtime_error("SLOB: Text index is corrupt");
+    return m_terms.substr(begin, end - begin);
+}
+
+U_INT SLOBTextIndex::find(std::string_view word) const
+{
+    U_INT low = 0, high = m_term_count;
+    while (low < high) {
+        U_INT middle = low + (high - low) / 2;
+        if (term(middle) < word)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low < m_term_count && term(low) == word)
+        return low;
+    return m_term_count;
+}
+
+std::vector<SLOBTextIndex::Posting> SLOBTextIndex::postings(U_INT index) const
+{
+    U_LONG_LONG begin = load_long(m_posting_offsets + (size_t)index * U_LONG_LONG_SIZE);
+    U_LONG_LONG end = load_long(m_posting_offsets + ((size_t)index + 1) * U_LONG_LONG_SIZE);
+    if (begin > end || end > m_postings.size())
+        throw std::runtime_error("SLOB: Text index is corrupt");
+
+    std::string_view list = m_postings.substr(0, end);
+    std::vector<Posting> postings;
+    postings.reserve(load_int(m_document_frequencies + (size_t)index * U_INT_SIZE));
+
+    size_t pos = begin;
+    U_INT document = 0;
+    while (pos < end) {
+        document += read_varint(list, pos);
+        U_INT frequency = read_varint(list, pos);
+        if (document >= m_document_count)
+            throw std::runtime_error("SLOB: Text index is corrupt");
+        postings.push_back({ document, frequency });
+    }
+    return postings;
+}
+
+std::vector<SLOBTextHit> SLOBTextIndex::search(std::string_view query, QUERY::OPERATOR op,
+                                               size_t limit) const
+{
+    if (!m_open)
+        throw std::runtime_error("SLOB: Text index is not open");
+
+    std::vector<std::string> words;
+    tokenize(query, false, [&](std::string_view word) {
+        words.emplace_back(word);
+    });
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    // Score every document of the combined postings; AND only
+    // keeps the documents counted once per word.
+    std::unordered_map<U_INT, std::pair<double, size_t>> scores;
+    size_t found = 0;
+    for (const std::string &word : words) {
+        U_INT index = find(word);
+        if (index == m_term_count)
+            continue;
+        found++;
+
+        std::vector<Posting> list = postings(index);
+        double idf = std::log(1 + (m_document_count - list.size() + 0.5) / (list.size() + 0.5));
+        for (const Posting &posting : list) {
+            const char *document = m_documents + (size_t)posting.document * TEXT_INDEX_DOCUMENT_SIZE;
+            double length = load_int(document + U_INT_SIZE + U_SHORT_SIZE);
+            double tf = posting.frequency;
+            double norm = BM25_K1 * (1 - BM25_B + BM25_B * length / m_average_length);
+            auto &score = scores[posting.document];
+            score.first += idf * tf * (BM25_K1 + 1) / (tf + norm);
+            score.second++;
+        }
+    }
+    if (op == QUERY::AND && found < words.size())
+        return {};
+
+    std::vector<std::pair<double, U_INT>> ranked;
+    ranked.reserve(scores.size());
+    for (const auto &[document, score] : scores)
+        if (op == QUERY::OR || score.second == words.size())
+            ranked.emplace_back(score.first, document);
+
+    auto better = [](const auto &a, const auto &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    size_t count = limit > 0 ? std::min(limit, ranked.size()) : ranked.size();
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+
+    std::vector<SLOBTextHit> hits;
+    hits.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const char *document = m_documents + (size_t)ranked[i].second * TEXT_INDEX_DOCUMENT_SIZE;
+        U_SHORT item_index = (U_CHAR)document[U_INT_SIZE] | (U_CHAR)document[U_INT_SIZE + 1] << 8;
+        hits.push_back({ load_int(document), item_index, ranked[i].first });
+    }
+    return hits;
+}
@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+
+// Pool and queue of the worker running on this thread.
+static thread_local const SLOBThreadPool *current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+SLOBThreadPool::SLOBThreadPool(size_t threads)
+{
+    if (threads == 0)
+        threads = 1;
+
+    m_queues.reserve(threads);
+    for (size_t i = 0; i < threads; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++)
+        m_workers.emplace_back(&SLOBThreadPool::work, this, i);
+}
+
+SLOBThreadPool::~SLOBThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread &worker : m_workers)
+        worker.join();
+}
+
+void SLOBThreadPool::submit(std::function<void()> task)
+{
+    size_t queue;
+    if (current_pool == this)
+        queue = current_queue;
+    else
+        queue = m_next_queue++ % m_queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+        m_queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    // A worker counts itself as sleeping before checking for
+    // tasks, so either it sees this task, or this sees it.
+    m_pending++;
+    if (m_sleeping > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_condition.notify_one();
+    }
+}
+
+bool SLOBThreadPool::claim()
+{
+    size_t pending = m_pending;
+    while (pending > 0)
+        if (m_pending.compare_exchange_weak(pending, pending - 1))
+            return true;
+    return false;
+}
+
+std::function<void()> SLOBThreadPool::take(size_t index)
+{
+    // A claimed task is already queued, but another
+    // worker may be stealing it: retry until found.
+    while (true) {
+        for (size_t i = 0; i < m_queues.size(); i++) {
+            Queue &queue = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                std::function<void()> task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return task;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void SLOBThreadPool::work(size_t index)
+{
+    current_pool = this;
+    current_queue = index;
+
+    while (true) {
+        if (claim()) {
+            take(index)();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping++;
+        m_condition.wait(lock, [this]() { return m_stop || m_pending > 0; });
+        m_sleeping--;
+        if (m_stop && m_pending == 0)
+            return;
+    }
+}
@@ -0,0 +1,191 @@
+// Asynchronous item retrieval, with and without an executor.
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdexcept>
+#include <condition_variable>
+#include "slob.h"
+#include "async_reader.h"
+#include "slob_writer.h"
+#include "check.h"
+
+#define ITEM_COUNT 40
+#define BIN_ITEM_COUNT 3
+#define BIN_COUNT ((ITEM_COUNT + BIN_ITEM_COUNT - 1) / BIN_ITEM_COUNT)
+
+static std::string item_content(U_INT item)
+{
+    return "Item " + std::to_string(item) + std::string(item * 53 % 3000, 'y');
+}
+
+static std::string write_file()
+{
+    std::string path = temp_path("async.slob");
+
+    SLOBWriter writer(path.c_str());
+    writer.set_bin_item_count(BIN_ITEM_COUNT);
+    for (U_INT i = 0; i < ITEM_COUNT; i++)
+        writer.add_reference("key " + std::to_string(i), writer.add_item(item_content(i), "text/plain"));
+    writer.finalize();
+    return path;
+}
+
+// Counts completions, for the test to wait on.
+class Completions {
+public:
+    void add()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_count++;
+        m_changed.notify_all();
+    }
+
+    void wait(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [&]() { return m_count >= count; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    size_t m_count { 0 };
+};
+
+static void check_items(const SLOBReader &reader, SLOBThreadPool &pool, size_t queue_depth, bool executor)
+{
+    std::atomic<size_t> executed { 0 };
+    SLOBExecutor run;
+    if (executor) {
+        run = [&](std::function<void()> completion) {
+            executed++;
+            completion();
+        };
+    }
+    SLOBAsyncReader async_reader(reader, pool, run, queue_depth);
+
+    // Every item, twice, so requests share bins in flight.
+    std::mutex mutex;
+    std::vector<std::string> contents(ITEM_COUNT);
+    std::atomic<size_t> errors { 0 };
+    Completions completions;
+    for (U_INT round = 0; round < 2; round++) {
+        for (U_INT i = 0; i < ITEM_COUNT; i++) {
+            async_reader.item(i / BIN_ITEM_COUNT, i % BIN_ITEM_COUNT,
+                              [&, i](SLOBItemView item, std::exception_ptr error) {
+                if (error) {
+                    errors++;
+                } else {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    contents[i] = std::string(item.content);
+                    CHECK(item.content_type == "text/plain");
+                }
+                completions.add();
+            });
+        }
+    }
+    completions.wait(2 * ITEM_COUNT);
+    CHECK(errors == 0);
+    for (U_INT i = 0; i < ITEM_COUNT; i++)
+        CHECK(contents[i] == item_content(i));
+    CHECK(executed == (executor ? 2 * ITEM_COUNT : 0));
+
+    // Futures are fulfilled on the pool, even with an executor.
+    executed = 0;
+    std::vector<std::future<SLOBItemView>> futures;
+    for (U_INT i = 0; i < ITEM_COUNT; i++)
+        futures.push_back(async_reader.item(i / BIN_ITEM_COUNT, i % BIN_ITEM_COUNT));
+    for (U_INT i = 0; i < ITEM_COUNT; i++)
+        CHECK(futures[i].get().content == item_content(i));
+    CHECK(executed == 0);
+
+    // Errors complete the request, and only it.
+    for (U_SHORT item_index : { 0, BIN_ITEM_COUNT }) {
+        U_INT bin_index = item_index ? 0 : BIN_COUNT;
+        bool thrown = false;
+        try {
+            async_reader.item(bin_index, item_index).get();
+        } catch (const std::exception &) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    std::exception_ptr failed;
+    async_reader.item(BIN_COUNT, 0, [&](SLOBItemView, std::exception_ptr error) {
+        failed = error;
+        completions.add();
+    });
+    completions.wait(2 * ITEM_COUNT + 1);
+    CHECK(failed != nullptr);
+    CHECK(async_reader.item(1, 0).get().content == item_content(BIN_ITEM_COUNT));
+
+    // Throwing callbacks neither stop other completions nor
+    // keep the reader from being destroyed.
+    for (U_INT i = 0; i < ITEM_COUNT; i++) {
+        async_reader.item(i / BIN_ITEM_COUNT, i % BIN_ITEM_COUNT, [&](SLOBItemView, std::exception_ptr) {
+            completions.add();
+            throw std::runtime_error("callback");
+        });
+    }
+    completions.wait(3 * ITEM_COUNT + 1);
+    CHECK(async_reader.item(0, 0).get().content == item_content(0));
+}
+
+static void check_queue_depth(const SLOBReader &reader, SLOBThreadPool &pool)
+{
+    bool thrown = false;
+    try {
+        SLOBAsyncReader async_reader(reader, pool, nullptr, 0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    SLOBAsyncReader async_reader(reader, pool, nullptr, 1);
+    thrown = false;
+    try {
+        async_reader.set_queue_depth(0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // Requests queued behind a depth of one all complete,
+    // also after the depth grows.
+    std::vector<std::future<SLOBItemView>> futures;
+    for (U_INT i = 0; i < ITEM_COUNT; i++) {
+        futures.push_back(async_reader.item(i / BIN_ITEM_COUNT, i % BIN_ITEM_COUNT));
+        if (i == ITEM_COUNT / 2)
+            async_reader.set_queue_depth(8);
+    }
+    for (U_INT i = 0; i < ITEM_COUNT; i++)
+        CHECK(futures[i].get().content == item_content(i));
+    CHECK(async_reader.pending() == 0);
+}
+
+int main()
+{
+    std::string path = write_file();
+
+    // Stream backed files go through io_uring when built with
+    // SLOB_IO_URING, mapped ones always through the pool.
+    for (size_t threads : { 1, 4 }) {
+        SLOBThreadPool pool(threads);
+        for (BACKEND::TYPE backend : { BACKEND::STREAM, BACKEND::MMAP }) {
+            for (size_t cache_size : { 0, 4 }) {
+                SLOBReader reader;
+                reader.open_file(path.c_str(), REFERENCES::EAGER, backend);
+                reader.set_bin_cache_size(cache_size);
+                for (size_t queue_depth : { 1, 4, DEFAULT_ASYNC_QUEUE_DEPTH })
+                    for (bool executor : { false, true })
+                        check_items(reader, pool, queue_depth, executor);
+                check_queue_depth(reader, pool);
+            }
+        }
+    }
+
+    std::remove(path.c_str());
+    return check_result();
+}
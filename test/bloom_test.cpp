@@ -0,0 +1,157 @@
+// Bloom filter lookups against lookups without the filter.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdexcept>
+#include <unicode/utf8.h>
+#include "slob.h"
+#include "dictionary.h"
+#include "bloom_filter.h"
+#include "collation_index.h"
+#include "slob_writer.h"
+#include "check.h"
+
+static const std::vector<std::string> SYLLABLES {
+    "ka", "Lo", "mi", "ré", "su", "ön", "те", "ж", "ta", "ex", "",
+};
+
+static std::vector<std::string> make_keys()
+{
+    std::vector<std::string> keys;
+    for (const std::string &a : SYLLABLES)
+        for (const std::string &b : SYLLABLES)
+            for (const std::string &c : SYLLABLES)
+                keys.push_back(a + b + c + (a.size() % 2 ? " word" : ""));
+    return keys;
+}
+
+static std::string write_file(const std::string &name, const std::vector<std::string> &keys)
+{
+    std::string path = temp_path(name);
+
+    SLOBWriter writer(path.c_str());
+    for (const std::string &key : keys)
+        writer.add_reference(key, writer.add_item("Item " + key, "text/plain"));
+    writer.finalize();
+    return path;
+}
+
+// Every prefix of the key, on code point boundaries.
+static std::vector<std::string> prefixes(const std::string &key)
+{
+    std::vector<std::string> result;
+    for (int32_t i = 0; i < (int32_t)key.size();) {
+        UChar32 c;
+        U8_NEXT(key.data(), i, (int32_t)key.size(), c);
+        result.push_back(key.substr(0, i));
+    }
+    return result;
+}
+
+static std::vector<std::string> lookup(SLOBDict &dict, const std::string &term)
+{
+    std::vector<std::string> keys;
+    for (const SLOBReference &ref : dict[term])
+        keys.push_back(ref.key);
+    return keys;
+}
+
+int main()
+{
+    std::vector<std::string> keys = make_keys();
+    std::string path = write_file("bloom.slob", keys);
+    std::string filter_path = path + BLOOM_FILTER_EXTENSION;
+    std::string index_path = path + COLLATION_INDEX_EXTENSION;
+    std::string other_path = write_file("bloom-other.slob", { "other" });
+    std::string other_filter_path = other_path + BLOOM_FILTER_EXTENSION;
+    std::string other_index_path = other_path + COLLATION_INDEX_EXTENSION;
+
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+    CollationKeyList key_list(reader);
+    SLOBBloomFilter::build(reader, key_list, filter_path.c_str());
+    SLOBCollationIndex::build(reader, key_list, index_path.c_str());
+
+    SLOBReader other_reader;
+    other_reader.open_file(other_path.c_str());
+    CollationKeyList other_key_list(other_reader);
+    SLOBBloomFilter::build(other_reader, other_key_list, other_filter_path.c_str());
+    SLOBCollationIndex::build(other_reader, other_key_list, other_index_path.c_str());
+
+    SLOBDict plain(reader);
+    SLOBDict filtered(reader);
+    filtered.open_filter(filter_path.c_str());
+    SLOBDict indexed(reader);
+    indexed.open_filter(filter_path.c_str());
+    indexed.open_index(index_path.c_str());
+
+    // No false negatives: every prefix of every key finds
+    // what it finds without the filter.
+    SLOBBloomFilter filter;
+    filter.open(filter_path.c_str(), reader, key_list);
+    for (const std::string &key : keys) {
+        CHECK(filter.may_contain(key_list.sort_key(key)));
+        for (const std::string &prefix : prefixes(key)) {
+            std::vector<std::string> expected = lookup(plain, prefix);
+            CHECK(!expected.empty());
+            CHECK(lookup(filtered, prefix) == expected);
+            CHECK(lookup(indexed, prefix) == expected);
+        }
+    }
+
+    // Most absent terms are ruled out.
+    size_t passed = 0;
+    for (U_INT i = 0; i < 1000; i++) {
+        std::string term = "zq" + std::to_string(i * 7919) + "absent";
+        CHECK(lookup(filtered, term).empty());
+        if (filter.may_contain(key_list.sort_key(term)))
+            passed++;
+    }
+    CHECK(passed < 100);
+
+    // A filter or index of another file is rejected, and
+    // leaves it closed: lookups still find every key.
+    bool thrown = false;
+    try {
+        filter.open(other_filter_path.c_str(), reader, key_list);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!filter.is_open());
+    CHECK(filter.may_contain(key_list.sort_key("zq0absent")));
+
+    SLOBCollationIndex index;
+    index.open(index_path.c_str(), reader, key_list);
+    CHECK(index.is_open() && index.size() == keys.size());
+    thrown = false;
+    try {
+        index.open(other_index_path.c_str(), reader, key_list);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!index.is_open() && index.size() == 0);
+
+    thrown = false;
+    try {
+        indexed.open_filter(other_filter_path.c_str());
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        indexed.open_index(other_index_path.c_str());
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    for (const std::string &key : keys)
+        CHECK(lookup(indexed, key) == lookup(plain, key));
+
+    for (const std::string &file : { path, filter_path, index_path, other_path, other_filter_path,
+                                     other_index_path })
+        std::remove(file.c_str());
+    return check_result();
+}
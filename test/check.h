@@ -0,0 +1,36 @@
+// Checks shared by the tests
+#ifndef _CHECK_H
+#define _CHECK_H
+
+#include <string>
+#include <iostream>
+#include <filesystem>
+
+// Report a failed condition, and keep going.
+#define CHECK(condition)                                                      \
+    do {                                                                      \
+        if (!(condition)) {                                                   \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": " #condition "\n"; \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+static int failures = 0;
+
+// Path of a scratch file in the temporary directory.
+inline std::string temp_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("slob-test-" + name)).string();
+}
+
+// Exit status of a test.
+inline int check_result()
+{
+    if (failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+#endif
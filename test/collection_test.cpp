@@ -0,0 +1,143 @@
+// Collection lookups merging several dictionaries.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include "slob.h"
+#include "dictionary.h"
+#include "collection.h"
+#include "collation_index.h"
+#include "bloom_filter.h"
+#include "thread_pool.h"
+#include "slob_writer.h"
+#include "check.h"
+
+static const std::vector<std::vector<std::string>> DICTIONARIES {
+    { "apple", "Apple", "banana", "cherry", "apricot jam" },
+    { "apple", "apricot", "blueberry", "Cherry" },
+    { "avocado", "banana", "Banana split", "ápple" },
+    {},
+};
+
+static std::string write_file(size_t index)
+{
+    std::string path = temp_path("collection-" + std::to_string(index) + ".slob");
+
+    SLOBWriter writer(path.c_str());
+    for (const std::string &key : DICTIONARIES[index])
+        writer.add_reference(key, writer.add_item(std::to_string(index) + ":" + key, "text/plain"));
+    writer.finalize();
+    return path;
+}
+
+struct Expected {
+    std::string sort_key;
+    size_t dictionary;
+    size_t order;
+    std::string key;
+};
+
+// Every dictionary's matches, merged by sort key, then
+// dictionary, then their order in the dictionary.
+static std::vector<Expected> expected_matches(SLOBCollection &collection, const std::string &term)
+{
+    std::vector<Expected> expected;
+    for (size_t i = 0; i < collection.size(); i++) {
+        SLOBMatchRange range = collection.dict(i).lookup(term);
+        size_t order = 0;
+        for (auto it = range.begin(); it != range.end(); ++it)
+            expected.push_back({ it.sort_key(), i, order++, std::string((*it).key) });
+    }
+    std::sort(expected.begin(), expected.end(), [](const Expected &a, const Expected &b) {
+        if (a.sort_key != b.sort_key)
+            return a.sort_key < b.sort_key;
+        return a.dictionary != b.dictionary ? a.dictionary < b.dictionary : a.order < b.order;
+    });
+    return expected;
+}
+
+static bool same_matches(const std::vector<SLOBCollectionMatch> &matches,
+                         const std::vector<Expected> &expected)
+{
+    if (matches.size() != expected.size())
+        return false;
+    for (size_t i = 0; i < matches.size(); i++)
+        if (matches[i].dictionary != expected[i].dictionary
+                || matches[i].reference.key != expected[i].key)
+            return false;
+    return true;
+}
+
+static void check_collection(const std::vector<std::string> &paths, SLOBThreadPool *pool)
+{
+    SLOBCollection collection(pool);
+    for (const std::string &path : paths)
+        collection.open_file(path.c_str());
+    CHECK(collection.size() == DICTIONARIES.size());
+
+    for (const std::string term : { "a", "ap", "APPLE", "b", "banana", "c", "cherry", "missing" }) {
+        std::vector<Expected> expected = expected_matches(collection, term);
+        std::vector<SLOBCollectionMatch> matches = collection[term];
+        CHECK(same_matches(matches, expected));
+        for (const SLOBCollectionMatch &match : matches)
+            CHECK(match.uuid == collection.reader(match.dictionary).uuid());
+
+        // Pages of any size add up to the whole result.
+        for (size_t limit : { 1, 2, 3, 100 }) {
+            std::vector<SLOBCollectionMatch> paged;
+            SLOBCollectionPage page { {}, {}, false };
+            size_t pages = 0;
+            while (!page.complete && pages++ <= expected.size()) {
+                page = collection.prefix_search(term, limit, page.next);
+                CHECK(page.matches.size() <= limit);
+                CHECK(page.complete || page.matches.size() == limit);
+                paged.insert(paged.end(), page.matches.begin(), page.matches.end());
+            }
+            CHECK(page.complete);
+            CHECK(same_matches(paged, expected));
+        }
+    }
+
+    // Equal keys come in the order the dictionaries were
+    // opened, ahead of longer keys.
+    std::vector<SLOBCollectionMatch> matches = collection["banana"];
+    CHECK(matches.size() == 3);
+    if (matches.size() == 3) {
+        CHECK(matches[0].dictionary == 0 && matches[0].reference.key == "banana");
+        CHECK(matches[1].dictionary == 2 && matches[1].reference.key == "banana");
+        CHECK(matches[2].dictionary == 2 && matches[2].reference.key == "Banana split");
+    }
+    CHECK(collection["missing"].empty());
+}
+
+int main()
+{
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < DICTIONARIES.size(); i++)
+        paths.push_back(write_file(i));
+
+    SLOBThreadPool pool(4);
+    check_collection(paths, nullptr);
+    check_collection(paths, &pool);
+
+    // Collation indexes and filters beside the files are
+    // opened with them, and give the same results.
+    std::vector<std::string> sidecars;
+    for (const std::string &path : paths) {
+        SLOBReader reader;
+        reader.open_file(path.c_str());
+        CollationKeyList key_list(reader);
+        sidecars.push_back(path + COLLATION_INDEX_EXTENSION);
+        SLOBCollationIndex::build(reader, key_list, sidecars.back().c_str());
+        sidecars.push_back(path + BLOOM_FILTER_EXTENSION);
+        SLOBBloomFilter::build(reader, key_list, sidecars.back().c_str());
+    }
+    check_collection(paths, nullptr);
+    check_collection(paths, &pool);
+
+    for (const std::string &file : paths)
+        std::remove(file.c_str());
+    for (const std::string &file : sidecars)
+        std::remove(file.c_str());
+    return check_result();
+}
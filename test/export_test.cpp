@@ -0,0 +1,86 @@
+// JSONL and TSV export escaping.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <sstream>
+#include "slob.h"
+#include "exporter.h"
+#include "thread_pool.h"
+#include "slob_writer.h"
+#include "check.h"
+
+struct Record {
+    std::string key;
+    std::string fragment;
+    std::string content;
+    std::string content_type;
+};
+
+// One bin per item, so records come in this order.
+static const std::vector<Record> RECORDS {
+    { "say \"hi\"\\", "sec\t1", "line1\nline2\r\t\"q\" \\ \x01\x1f é", "text/plain" },
+    { "bin3", "", "\xff\xfe\xfd", "application/octet-stream" },
+    { "bin1", "", "\x80", "application/octet-stream" },
+    { "bin2", "", "a\xc0", "application/octet-stream" },
+    { "empty", "", "", "text/plain" },
+};
+
+static const std::string JSONL =
+    R"({"key":"say \"hi\"\\","fragment":"sec\t1","content_type":"text/plain",)"
+    R"("content":"line1\nline2\r\t\"q\" \\ \u0001\u001f é"})" "\n"
+    R"({"key":"bin3","fragment":"","content_type":"application/octet-stream",)"
+    R"("content":"//79","encoding":"base64"})" "\n"
+    R"({"key":"bin1","fragment":"","content_type":"application/octet-stream",)"
+    R"("content":"gA==","encoding":"base64"})" "\n"
+    R"({"key":"bin2","fragment":"","content_type":"application/octet-stream",)"
+    R"("content":"YcA=","encoding":"base64"})" "\n"
+    R"({"key":"empty","fragment":"","content_type":"text/plain","content":""})" "\n";
+
+// Binary content is written as is.
+static const std::string TSV =
+    "say \"hi\"\\\\\tsec\\t1\ttext/plain\tline1\\nline2\\r\\t\"q\" \\\\ \x01\x1f é\n"
+    "bin3\t\tapplication/octet-stream\t\xff\xfe\xfd\n"
+    "bin1\t\tapplication/octet-stream\t\x80\n"
+    "bin2\t\tapplication/octet-stream\ta\xc0\n"
+    "empty\t\ttext/plain\t\n";
+
+static std::string write_file()
+{
+    std::string path = temp_path("export.slob");
+
+    SLOBWriter writer(path.c_str());
+    writer.set_bin_item_count(1);
+    for (const Record &record : RECORDS)
+        writer.add_reference(record.key, writer.add_item(record.content, record.content_type), record.fragment);
+    writer.finalize();
+    return path;
+}
+
+static std::string export_file(SLOBReader &reader, SLOBThreadPool *pool, EXPORT::FORMAT format,
+                               size_t &records)
+{
+    SLOBExporter exporter(reader, pool);
+    exporter.set_format(format);
+    std::ostringstream out;
+    records = exporter.write(out);
+    return out.str();
+}
+
+int main()
+{
+    std::string path = write_file();
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+
+    SLOBThreadPool pool(4);
+    for (SLOBThreadPool *exporter_pool : { (SLOBThreadPool *)nullptr, &pool }) {
+        size_t records = 0;
+        CHECK(export_file(reader, exporter_pool, EXPORT::JSONL, records) == JSONL);
+        CHECK(records == RECORDS.size());
+        CHECK(export_file(reader, exporter_pool, EXPORT::TSV, records) == TSV);
+        CHECK(records == RECORDS.size());
+    }
+
+    std::remove(path.c_str());
+    return check_result();
+}
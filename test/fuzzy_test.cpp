@@ -0,0 +1,153 @@
+// Fuzzy key search against a brute force edit distance.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include <unicode/utf8.h>
+#include "slob.h"
+#include "folding.h"
+#include "dictionary.h"
+#include "slob_writer.h"
+#include "check.h"
+
+static const std::vector<std::string> KEYS {
+    "apple", "Apple", "apply", "ample", "maple", "appl", "applesauce",
+    "äpfel", "Apfel", "banana", "bandana", "ёж", "еж", "a", "",
+};
+
+static std::string write_file(const std::string &name, const std::vector<std::string> &keys)
+{
+    std::string path = temp_path(name);
+
+    SLOBWriter writer(path.c_str());
+    for (const std::string &key : keys)
+        writer.add_reference(key, writer.add_item("Item " + key, "text/plain"));
+    writer.finalize();
+    return path;
+}
+
+static std::vector<UChar32> code_points(std::string_view text)
+{
+    std::vector<UChar32> points;
+    for (int32_t i = 0; i < (int32_t)text.size();) {
+        UChar32 c;
+        U8_NEXT(text.data(), i, (int32_t)text.size(), c);
+        points.push_back(c);
+    }
+    return points;
+}
+
+static U_INT edit_distance(std::string_view a, std::string_view b)
+{
+    std::vector<UChar32> x = code_points(a), y = code_points(b);
+    std::vector<U_INT> row(y.size() + 1);
+    for (size_t j = 0; j <= y.size(); j++)
+        row[j] = j;
+    for (size_t i = 1; i <= x.size(); i++) {
+        U_INT diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= y.size(); j++) {
+            U_INT above = row[j];
+            row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (x[i - 1] != y[j - 1]) });
+            diagonal = above;
+        }
+    }
+    return row[y.size()];
+}
+
+static void check_search(const SLOBReader &reader, SLOBDict &dict, const std::string &term,
+                         U_INT max_distance)
+{
+    std::vector<SLOBFuzzyMatch> matches = dict.fuzzy_search(term, max_distance);
+
+    // Every reference within the distance, closest first, then
+    // in folded key order.
+    std::vector<std::pair<U_INT, std::string>> expected;
+    for (U_INT i = 0; i < reader.ref_count(); i++) {
+        std::string key = reader.reference(i).key;
+        U_INT distance = edit_distance(fold_key(key), fold_key(term));
+        if (distance <= max_distance)
+            expected.push_back({ distance, key });
+    }
+    CHECK(matches.size() == expected.size());
+
+    std::vector<std::pair<U_INT, std::string>> found;
+    for (size_t i = 0; i < matches.size(); i++) {
+        const SLOBFuzzyMatch &match = matches[i];
+        CHECK(match.distance == edit_distance(fold_key(match.reference.key), fold_key(term)));
+        if (i > 0) {
+            const SLOBFuzzyMatch &previous = matches[i - 1];
+            CHECK(previous.distance < match.distance ||
+                  (previous.distance == match.distance &&
+                   fold_key(previous.reference.key) <= fold_key(match.reference.key)));
+        }
+        found.push_back({ match.distance, match.reference.key });
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    CHECK(found == expected);
+}
+
+int main()
+{
+    std::string path = write_file("fuzzy.slob", KEYS);
+    std::string index_path = path + FUZZY_INDEX_EXTENSION;
+    std::string other_path = write_file("fuzzy-other.slob", { "other" });
+    std::string other_index_path = other_path + FUZZY_INDEX_EXTENSION;
+
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+    SLOBFuzzyIndex::build(reader, index_path.c_str());
+
+    SLOBReader other_reader;
+    other_reader.open_file(other_path.c_str());
+    SLOBFuzzyIndex::build(other_reader, other_index_path.c_str());
+
+    SLOBDict dict(reader);
+    dict.open_fuzzy_index(index_path.c_str());
+
+    for (const std::string term : { "aple", "APPLE", "apfel", "bananas", "ež", "x", "", "applesauces" })
+        for (U_INT max_distance : { 0, 1, 2, 3 })
+            check_search(reader, dict, term, max_distance);
+
+    // Keys differing in case and accents only are one key.
+    std::vector<SLOBFuzzyMatch> matches = dict.fuzzy_search("apfel", 0);
+    CHECK(matches.size() == 2);
+    for (const SLOBFuzzyMatch &match : matches)
+        CHECK(match.distance == 0 && (match.reference.key == "äpfel" || match.reference.key == "Apfel"));
+
+    // The limit counts keys, not references: the closest key
+    // has two references here.
+    matches = dict.fuzzy_search("Äpfels", 2, 1);
+    CHECK(matches.size() == 2);
+    for (const SLOBFuzzyMatch &match : matches)
+        CHECK(match.distance == 1 && (match.reference.key == "äpfel" || match.reference.key == "Apfel"));
+    // ample, then apple (twice); maple is past the limit.
+    CHECK(dict.fuzzy_search("aple", 1, 2).size() == 3);
+    CHECK(dict.fuzzy_search("aple", 1).size() == 4);
+
+    // An index of another file is rejected, and leaves the
+    // dictionary without a fuzzy index.
+    bool thrown = false;
+    try {
+        dict.open_fuzzy_index(other_index_path.c_str());
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::string error;
+    try {
+        dict.fuzzy_search("apple", 1);
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    CHECK(error == "SLOB: Fuzzy index is not open");
+
+    dict.open_fuzzy_index(index_path.c_str());
+    CHECK(dict.fuzzy_search("apple", 0).size() == 2);
+
+    for (const std::string &file : { path, index_path, other_path, other_index_path })
+        std::remove(file.c_str());
+    return check_result();
+}
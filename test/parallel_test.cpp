@@ -0,0 +1,187 @@
+// Parallel iteration over bins and items on a thread pool.
+#include <set>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "slob.h"
+#include "slob_writer.h"
+#include "check.h"
+
+#define ITEM_COUNT 50
+#define BIN_ITEM_COUNT 4
+#define BIN_COUNT ((ITEM_COUNT + BIN_ITEM_COUNT - 1) / BIN_ITEM_COUNT)
+
+static std::string item_content(U_INT item)
+{
+    // Varying sizes, so bins take varying times to decompress.
+    return "Item " + std::to_string(item) + std::string(item * 37 % 2000, 'x');
+}
+
+static std::string write_file()
+{
+    std::string path = temp_path("parallel.slob");
+
+    SLOBWriter writer(path.c_str());
+    writer.set_bin_item_count(BIN_ITEM_COUNT);
+    for (U_INT i = 0; i < ITEM_COUNT; i++) {
+        U_INT item = writer.add_item(item_content(i), i % 2 ? "text/plain" : "text/html");
+        writer.add_reference("key " + std::to_string(i), item);
+    }
+    writer.finalize();
+    return path;
+}
+
+// Overwrite the end of the last bin's compressed content.
+static std::string write_corrupt_file(const std::string &path)
+{
+    std::string corrupt_path = temp_path("parallel-corrupt.slob");
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (size_t i = data.size() - 8; i < data.size(); i++)
+        data[i] = '\xa5';
+
+    std::ofstream out(corrupt_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    out << data;
+    return corrupt_path;
+}
+
+static void check_thread_pool(SLOBThreadPool &pool)
+{
+    // Every task runs once, including tasks submitted by workers.
+    std::atomic<int> runs { 0 };
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 1000; i++) {
+        results.push_back(pool.async([&, i]() {
+            if (i % 10 == 0)
+                pool.submit([&]() { runs++; });
+            runs++;
+            return i;
+        }));
+    }
+    for (int i = 0; i < 1000; i++)
+        CHECK(results[i].get() == i);
+
+    std::future<void> failed = pool.async([]() { throw std::runtime_error("task"); });
+    bool thrown = false;
+    try {
+        failed.get();
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // Tasks submitted by workers may still be running.
+    while (runs < 1100)
+        std::this_thread::yield();
+    CHECK(runs == 1100);
+}
+
+static void check_iteration(const SLOBReader &reader, SLOBThreadPool &pool, size_t window)
+{
+    // Ordered delivery follows bin order.
+    std::vector<U_INT> bins;
+    reader.for_each_bin([&](U_INT bin_index, std::shared_ptr<const SLOBStoreItem> store_item) {
+        CHECK(store_item->content_type_ids.size() == reader.bin_item_count(bin_index));
+        bins.push_back(bin_index);
+        return false;
+    }, pool, DELIVERY::ORDERED, window);
+    CHECK(bins.size() == BIN_COUNT);
+    for (U_INT i = 0; i < bins.size(); i++)
+        CHECK(bins[i] == i);
+
+    // Unordered delivery still delivers every bin once.
+    std::multiset<U_INT> unordered;
+    reader.for_each_bin([&](U_INT bin_index, std::shared_ptr<const SLOBStoreItem>) {
+        unordered.insert(bin_index);
+        return false;
+    }, pool, DELIVERY::UNORDERED, window);
+    CHECK(unordered.size() == BIN_COUNT);
+    CHECK(std::set<U_INT>(unordered.begin(), unordered.end()).size() == BIN_COUNT);
+
+    // Items match sequential iteration, in order.
+    std::vector<std::string> sequential;
+    reader.for_each_item([&](const SLOBItem &item) {
+        sequential.push_back(item.content_type + ":" + item.content);
+        return false;
+    });
+    std::vector<std::string> parallel;
+    reader.for_each_item([&](const SLOBItemView &item) {
+        parallel.push_back(std::string(item.content_type) + ":" + std::string(item.content));
+        return false;
+    }, pool, DELIVERY::ORDERED, window);
+    CHECK(sequential.size() == ITEM_COUNT);
+    CHECK(parallel == sequential);
+    if (!parallel.empty())
+        CHECK(parallel[0] == "text/html:" + item_content(0));
+
+    // Returning true stops delivery.
+    size_t delivered = 0;
+    reader.for_each_item([&](const SLOBItemView &) {
+        return ++delivered == 5;
+    }, pool, DELIVERY::ORDERED, window);
+    CHECK(delivered == 5);
+
+    // Exceptions from the callback propagate, and stop delivery.
+    delivered = 0;
+    bool thrown = false;
+    try {
+        reader.for_each_bin([&](U_INT bin_index, std::shared_ptr<const SLOBStoreItem>) {
+            delivered++;
+            if (bin_index == 2)
+                throw std::logic_error("callback");
+            return false;
+        }, pool, DELIVERY::ORDERED, window);
+    } catch (const std::logic_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(delivered == 3);
+}
+
+static void check_corrupt_file(const std::string &path, SLOBThreadPool &pool)
+{
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+
+    // Bins before the corrupt one are delivered, then its error.
+    std::vector<U_INT> bins;
+    bool thrown = false;
+    try {
+        reader.for_each_bin([&](U_INT bin_index, std::shared_ptr<const SLOBStoreItem>) {
+            bins.push_back(bin_index);
+            return false;
+        }, pool);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(bins.size() == BIN_COUNT - 1);
+}
+
+int main()
+{
+    std::string path = write_file();
+    std::string corrupt_path = write_corrupt_file(path);
+
+    for (size_t threads : { 1, 4 }) {
+        SLOBThreadPool pool(threads);
+        check_thread_pool(pool);
+
+        for (BACKEND::TYPE backend : { BACKEND::STREAM, BACKEND::MMAP }) {
+            SLOBReader reader;
+            reader.open_file(path.c_str(), REFERENCES::EAGER, backend);
+            for (size_t window : { 0, 1, 3 })
+                check_iteration(reader, pool, window);
+        }
+        check_corrupt_file(corrupt_path, pool);
+    }
+
+    std::remove(path.c_str());
+    std::remove(corrupt_path.c_str());
+    return check_result();
+}
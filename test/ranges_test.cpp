@@ -0,0 +1,207 @@
+// Lazy ranges over references, store items and items.
+#include <string>
+#include <vector>
+#include <ranges>
+#include <cstdio>
+#include <fstream>
+#include "slob.h"
+#include "dictionary.h"
+#include "metrics.h"
+#include "slob_writer.h"
+#include "check.h"
+
+#define ITEM_COUNT 10
+#define BIN_ITEM_COUNT 3
+
+static std::string item_content(U_INT item)
+{
+    return "Item " + std::to_string(item);
+}
+
+static std::string write_file(const std::string &compression)
+{
+    std::string path = temp_path("ranges-" + (compression.empty() ? "none" : compression) + ".slob");
+
+    SLOBWriter writer(path.c_str(), compression);
+    writer.set_bin_item_count(BIN_ITEM_COUNT);
+    for (U_INT i = 0; i < ITEM_COUNT; i++) {
+        U_INT item = writer.add_item(item_content(i), "text/plain");
+        writer.add_reference("key " + std::to_string(i), item);
+    }
+    writer.finalize();
+    return path;
+}
+
+template <typename T>
+static void append_number(std::string &out, T value)
+{
+    for (int i = sizeof(T) - 1; i >= 0; i--)
+        out.push_back(value >> (8 * i));
+}
+
+// An uncompressed file whose bins (of the given item counts) can
+// be empty, which SLOBWriter never writes. It has no references.
+static std::string write_file_with_empty_bins(const std::vector<U_INT> &bin_item_counts)
+{
+    std::string path = temp_path("ranges-empty-bins.slob");
+
+    std::string bins;
+    std::vector<U_LONG_LONG> positions;
+    U_INT item = 0;
+    for (U_INT count : bin_item_counts) {
+        std::vector<std::string> items;
+        for (U_INT i = 0; i < count; i++)
+            items.push_back(item_content(item++));
+
+        std::string content;
+        U_INT position = 0;
+        for (const std::string &content_item : items) {
+            append_number<U_INT>(content, position);
+            position += U_INT_SIZE + content_item.size();
+        }
+        for (const std::string &content_item : items) {
+            append_number<U_INT>(content, content_item.size());
+            content.append(content_item);
+        }
+
+        positions.push_back(bins.size());
+        append_number<U_INT>(bins, count);
+        bins.append(count, '\0');
+        append_number<U_INT>(bins, content.size());
+        bins.append(content);
+    }
+
+    std::string header(MAGIC);
+    header.append(16, 'u');
+    append_number<U_CHAR>(header, 5);
+    header.append(UTF8);
+    append_number<U_CHAR>(header, 0);
+    append_number<U_CHAR>(header, 0);
+    append_number<U_CHAR>(header, 1);
+    append_number<U_SHORT>(header, 10);
+    header.append("text/plain");
+    append_number<U_INT>(header, item);
+
+    std::string refs;
+    append_number<U_INT>(refs, 0);
+
+    std::string store;
+    append_number<U_INT>(store, positions.size());
+    for (U_LONG_LONG position : positions)
+        append_number<U_LONG_LONG>(store, position);
+    store.append(bins);
+
+    U_LONG_LONG store_offset = header.size() + 2 * U_LONG_LONG_SIZE + refs.size();
+    append_number<U_LONG_LONG>(header, store_offset);
+    append_number<U_LONG_LONG>(header, store_offset + store.size());
+
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    out << header << refs << store;
+    return path;
+}
+
+static uint64_t decompressed_bytes()
+{
+    SLOBMetricsSnapshot snapshot = SLOBMetrics::snapshot();
+    return snapshot.counters[METRIC::DECOMPRESSED_BYTES_LZMA2].value +
+           snapshot.counters[METRIC::DECOMPRESSED_BYTES_ZLIB].value +
+           snapshot.counters[METRIC::DECOMPRESSED_BYTES_NONE].value;
+}
+
+static void check_file(const std::string &path, REFERENCES::LOADING loading, BACKEND::TYPE backend)
+{
+    SLOBReader reader;
+    reader.open_file(path.c_str(), loading, backend);
+
+    // References come in collation order, and ranges compose.
+    U_INT index = 0;
+    for (SLOBReferenceView ref : reader.references()) {
+        CHECK(ref.key == reader.reference(index).key);
+        index++;
+    }
+    CHECK(index == ITEM_COUNT);
+
+    std::vector<std::string> keys;
+    for (SLOBReferenceView ref : reader.references() | std::views::take(2))
+        keys.push_back(std::string(ref.key));
+    CHECK(keys.size() == 2 && keys[0] == "key 0" && keys[1] == "key 1");
+
+    U_INT bin_index = 0;
+    for (std::shared_ptr<const SLOBStoreItem> store_item : reader.store_items()) {
+        CHECK(store_item->content_type_ids.size() == reader.bin_item_count(bin_index));
+        bin_index++;
+    }
+    CHECK(bin_index == (ITEM_COUNT + BIN_ITEM_COUNT - 1) / BIN_ITEM_COUNT);
+
+    // Items come in the order they were added.
+    U_INT item = 0;
+    for (auto it = reader.items().begin(); it != reader.items().end(); ++it) {
+        CHECK(it.bin_index() == item / BIN_ITEM_COUNT);
+        CHECK(it.item_index() == item % BIN_ITEM_COUNT);
+        CHECK((*it).content == item_content(item));
+        CHECK((*it).content_type == "text/plain");
+        item++;
+    }
+    CHECK(item == ITEM_COUNT);
+
+    // Comparing and advancing iterators does not decompress.
+    uint64_t before = decompressed_bytes();
+    SLOBItemRange items = reader.items();
+    size_t count = 0;
+    for (auto it = items.begin(); it != items.end(); it++)
+        count++;
+    CHECK(count == ITEM_COUNT);
+    CHECK(items.begin() == items.begin());
+    CHECK(decompressed_bytes() == before);
+    if (SLOBMetrics::enabled()) {
+        CHECK((*items.begin()).content == item_content(0));
+        CHECK(decompressed_bytes() > before);
+    }
+
+    // Lookups match keys starting with the term, ignoring case.
+    SLOBDict dict(reader);
+    CHECK(std::ranges::distance(dict.lookup("key")) == ITEM_COUNT);
+    SLOBMatchRange matches = dict.lookup("KEY 3");
+    CHECK(matches.begin() != std::default_sentinel && (*matches.begin()).key == "key 3");
+    CHECK(std::ranges::distance(dict.lookup("key 3", 4)) == 0);
+    CHECK(dict.lookup("missing").empty());
+}
+
+static void check_empty_bins(BACKEND::TYPE backend)
+{
+    std::string path = write_file_with_empty_bins({ 0, 2, 0, 0, 1, 0 });
+    SLOBReader reader;
+    reader.open_file(path.c_str(), REFERENCES::EAGER, backend);
+    CHECK(reader.bin_count() == 6);
+
+    std::vector<std::pair<U_INT, U_SHORT>> positions;
+    std::vector<std::string> contents;
+    SLOBItemRange items = reader.items();
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        positions.push_back({ it.bin_index(), it.item_index() });
+        contents.push_back(std::string((*it).content));
+    }
+    CHECK((positions == std::vector<std::pair<U_INT, U_SHORT>> { { 1, 0 }, { 1, 1 }, { 4, 0 } }));
+    CHECK((contents == std::vector<std::string> { item_content(0), item_content(1), item_content(2) }));
+
+    // A range of empty bins is empty.
+    CHECK(SLOBItemRange(SLOBItemIterator(&reader, 5), SLOBItemIterator(&reader, 6)).empty());
+    CHECK(std::ranges::distance(reader.store_items()) == 6);
+    std::remove(path.c_str());
+}
+
+int main()
+{
+    for (const std::string compression : { "lzma2", "" }) {
+        std::string path = write_file(compression);
+        for (REFERENCES::LOADING loading : { REFERENCES::EAGER, REFERENCES::LAZY })
+            for (BACKEND::TYPE backend : { BACKEND::STREAM, BACKEND::MMAP })
+                check_file(path, loading, backend);
+        std::remove(path.c_str());
+    }
+
+    for (BACKEND::TYPE backend : { BACKEND::STREAM, BACKEND::MMAP })
+        check_empty_bins(backend);
+
+    return check_result();
+}
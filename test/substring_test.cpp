@@ -0,0 +1,115 @@
+// Substring key search against a brute force scan.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include "slob.h"
+#include "folding.h"
+#include "dictionary.h"
+#include "slob_writer.h"
+#include "check.h"
+
+static const std::vector<std::string> KEYS {
+    "black hole", "Black Hole", "white hole", "wormhole", "hole", "holy", "whole",
+    "Café", "cafe au lait", "décaféiné", "banana", "ёжик", "Ёж", "a", "",
+};
+
+static std::string write_file(const std::string &name, const std::vector<std::string> &keys)
+{
+    std::string path = temp_path(name);
+
+    SLOBWriter writer(path.c_str());
+    for (const std::string &key : keys)
+        writer.add_reference(key, writer.add_item("Item " + key, "text/plain"));
+    writer.finalize();
+    return path;
+}
+
+static void check_search(const SLOBReader &reader, SLOBDict &dict, const std::string &term)
+{
+    std::vector<SLOBReference> matches = dict.substring_search(term);
+
+    std::string folded = fold_key(term);
+    std::vector<std::string> expected;
+    if (!folded.empty()) {
+        for (U_INT i = 0; i < reader.ref_count(); i++) {
+            std::string key = reader.reference(i).key;
+            if (fold_key(key).find(folded) != std::string::npos)
+                expected.push_back(key);
+        }
+    }
+
+    // Matches come in folded key order, each reference once.
+    std::vector<std::string> found;
+    for (size_t i = 0; i < matches.size(); i++) {
+        if (i > 0)
+            CHECK(fold_key(matches[i - 1].key) <= fold_key(matches[i].key));
+        found.push_back(matches[i].key);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    CHECK(found == expected);
+}
+
+int main()
+{
+    std::string path = write_file("substring.slob", KEYS);
+    std::string index_path = path + SUBSTRING_INDEX_EXTENSION;
+    std::string other_path = write_file("substring-other.slob", { "other" });
+    std::string other_index_path = other_path + SUBSTRING_INDEX_EXTENSION;
+
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+    SLOBSubstringIndex::build(reader, index_path.c_str());
+
+    SLOBReader other_reader;
+    other_reader.open_file(other_path.c_str());
+    SLOBSubstringIndex::build(other_reader, other_index_path.c_str());
+
+    SLOBDict dict(reader);
+    dict.open_substring_index(index_path.c_str());
+
+    for (const std::string term : { "hole", "HOLE", "ole", "o", "caf", "CAFE", "éin", "ЁЖ",
+                                    "k h", "wormhole", "wormholes", "x", "a" })
+        check_search(reader, dict, term);
+
+    // Keys containing the term more than once match once.
+    CHECK(dict.substring_search("an").size() == 1);
+
+    // Empty terms, and terms folding to nothing, match nothing.
+    CHECK(dict.substring_search("").empty());
+    CHECK(dict.substring_search("\xcc\x81").empty());
+
+    // The limit counts keys, not references: "black hole"
+    // comes first, with two references.
+    std::vector<SLOBReference> matches = dict.substring_search("hole", 1);
+    CHECK(matches.size() == 2);
+    for (const SLOBReference &match : matches)
+        CHECK(match.key == "black hole" || match.key == "Black Hole");
+    CHECK(dict.substring_search("hole", 2).size() == 3);
+
+    // An index of another file is rejected, and leaves the
+    // dictionary without a substring index.
+    bool thrown = false;
+    try {
+        dict.open_substring_index(other_index_path.c_str());
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::string error;
+    try {
+        dict.substring_search("hole");
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    CHECK(error == "SLOB: Substring index is not open");
+
+    dict.open_substring_index(index_path.c_str());
+    CHECK(dict.substring_search("wormhole").size() == 1);
+
+    for (const std::string &file : { path, index_path, other_path, other_index_path })
+        std::remove(file.c_str());
+    return check_result();
+}
@@ -0,0 +1,152 @@
+// Full-text search ranking, and builds spilling to disk.
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "slob.h"
+#include "text_index.h"
+#include "thread_pool.h"
+#include "slob_writer.h"
+#include "check.h"
+
+#define BIN_ITEM_COUNT 2
+#define GENERATED_ITEM_COUNT 60
+
+static const std::vector<std::pair<std::string, std::string>> ITEMS {
+    { "Apple banana", "text/plain" },
+    { "apple APPLE apple", "text/plain" },
+    { "<p>banana <b>cherry</b></p><script>apple</script>", "text/html" },
+    { "apple", "image/png" },
+    { "Cherry pie, and a long sentence with many other words in it: apple", "text/plain" },
+};
+
+static std::string write_file(const std::string &name, bool generated)
+{
+    std::string path = temp_path(name);
+
+    SLOBWriter writer(path.c_str());
+    writer.set_bin_item_count(BIN_ITEM_COUNT);
+    for (const auto &[content, content_type] : ITEMS)
+        writer.add_reference(content, writer.add_item(content, content_type));
+    // Enough words for builds with a tiny memory budget to
+    // spill many runs.
+    for (U_INT i = 0; generated && i < GENERATED_ITEM_COUNT; i++) {
+        std::string content = "w" + std::to_string(i % 7) + " w" + std::to_string(i % 3) +
+                              " n" + std::to_string(i);
+        writer.add_reference(content, writer.add_item(content, "text/plain"));
+    }
+    writer.finalize();
+    return path;
+}
+
+// Item numbers of the hits, in order.
+static std::vector<U_INT> items(const std::vector<SLOBTextHit> &hits)
+{
+    std::vector<U_INT> numbers;
+    for (const SLOBTextHit &hit : hits)
+        numbers.push_back(hit.bin_index * BIN_ITEM_COUNT + hit.item_index);
+    return numbers;
+}
+
+static bool exists(const std::string &path)
+{
+    return std::ifstream(path).good();
+}
+
+static void check_search(const SLOBTextIndex &index)
+{
+    // More occurrences in a shorter item rank higher; binary
+    // items are not indexed.
+    CHECK((items(index.search("apple", QUERY::AND, 0)) == std::vector<U_INT> { 1, 0, 4 }));
+    CHECK(items(index.search("APPLE", QUERY::AND, 1)) == std::vector<U_INT> { 1 });
+
+    std::vector<SLOBTextHit> hits = index.search("apple banana cherry", QUERY::OR, 0);
+    CHECK((items(hits).size() == 4));
+    for (size_t i = 1; i < hits.size(); i++)
+        CHECK(hits[i - 1].score >= hits[i].score);
+
+    CHECK(items(index.search("banana apple")) == std::vector<U_INT> { 0 });
+    CHECK(index.search("apple durian").empty());
+    CHECK(index.search("apple durian", QUERY::OR, 0).size() == 3);
+    CHECK(index.search("").empty());
+
+    // Tags, scripts and styles are not words.
+    CHECK((items(index.search("cherry", QUERY::AND, 0)) == std::vector<U_INT> { 2, 4 }));
+    CHECK(index.search("p").empty());
+    CHECK(index.search("script").empty());
+}
+
+static bool same_hits(const std::vector<SLOBTextHit> &a, const std::vector<SLOBTextHit> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].bin_index != b[i].bin_index || a[i].item_index != b[i].item_index
+                || a[i].score != b[i].score)
+            return false;
+    return true;
+}
+
+int main()
+{
+    std::string path = write_file("text.slob", true);
+    std::string index_path = path + TEXT_INDEX_EXTENSION;
+    std::string spilled_path = temp_path("text-spilled.slob" TEXT_INDEX_EXTENSION);
+    std::string other_path = write_file("text-other.slob", false);
+    std::string other_index_path = other_path + TEXT_INDEX_EXTENSION;
+
+    SLOBReader reader;
+    reader.open_file(path.c_str());
+    SLOBTextIndex::build(reader, index_path.c_str());
+
+    SLOBReader other_reader;
+    other_reader.open_file(other_path.c_str());
+    SLOBTextIndex::build(other_reader, other_index_path.c_str());
+
+    SLOBTextIndex index;
+    index.open(index_path.c_str(), reader);
+    CHECK(index.size() == ITEMS.size() - 1 + GENERATED_ITEM_COUNT);
+    check_search(index);
+
+    // Builds spilling every posting to its own run, on a pool
+    // or not, give the same index, and clean up their runs.
+    for (size_t threads : { 0, 4 }) {
+        SLOBThreadPool pool(threads ? threads : 1);
+        SLOBTextIndex::build(reader, spilled_path.c_str(), threads ? &pool : nullptr, 1);
+        CHECK(!exists(spilled_path + ".run0"));
+        CHECK(!exists(spilled_path + ".postings"));
+
+        SLOBTextIndex spilled;
+        spilled.open(spilled_path.c_str(), reader);
+        check_search(spilled);
+        for (const std::string query : { "w1", "w2 n5", "w0 w3 w6", "apple w1 cherry" })
+            for (QUERY::OPERATOR op : { QUERY::AND, QUERY::OR })
+                CHECK(same_hits(spilled.search(query, op, 0), index.search(query, op, 0)));
+    }
+
+    // An index of another file is rejected, and leaves the
+    // index closed.
+    bool thrown = false;
+    try {
+        index.open(other_index_path.c_str(), reader);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!index.is_open());
+    std::string error;
+    try {
+        index.search("apple");
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    CHECK(error == "SLOB: Text index is not open");
+
+    index.open(index_path.c_str(), reader);
+    CHECK(index.search("apple").size() == 3);
+
+    for (const std::string &file : { path, index_path, spilled_path, other_path, other_index_path })
+        std::remove(file.c_str());
+    return check_result();
+}
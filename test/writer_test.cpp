@@ -0,0 +1,141 @@
+// Round trip of files written by SLOBWriter through SLOBReader.
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include "slob.h"
+#include "dictionary.h"
+#include "slob_writer.h"
+#include "check.h"
+
+using namespace std::string_view_literals;
+
+struct Entry {
+    std::string_view key;
+    std::string_view fragment;
+    std::string_view content;
+    std::string content_type;
+};
+
+static const std::vector<Entry> ENTRIES {
+    { "black hole", "", "<p>A region of spacetime.</p>", "text/html;charset=utf-8" },
+    { "Black Hole", "history", "<p>Coined in 1967.</p>", "text/html;charset=utf-8" },
+    { "apple", "", "A fruit.", "text/plain;charset=utf-8" },
+    { "Äpfel", "", "Apples, in German.", "text/plain;charset=utf-8" },
+    { "zebra", "stripes", "", "text/plain;charset=utf-8" },
+    { "ёж", "", "Hedgehog.\n\tIn Russian.", "text/plain;charset=utf-8" },
+    { "binary", "", "\x00\xff\x01"sv, "application/octet-stream" },
+};
+
+static std::string write_file(const std::string &compression, SLOBThreadPool *pool)
+{
+    std::string path = temp_path("writer-" + (compression.empty() ? "none" : compression) + ".slob");
+
+    SLOBWriter writer(path.c_str(), compression, pool);
+    // Several bins, so references point across bins.
+    writer.set_bin_item_count(2);
+    writer.set_uuid("0123456789abcdef");
+    writer.tag("label", "Writer test");
+    writer.tag("source", "");
+
+    for (const Entry &entry : ENTRIES) {
+        U_INT item = writer.add_item(entry.content, entry.content_type);
+        writer.add_reference(entry.key, item, entry.fragment);
+    }
+    // A second key for the first item.
+    writer.add_reference("singularity", 0);
+
+    CHECK(writer.item_count() == ENTRIES.size());
+    CHECK(writer.ref_count() == ENTRIES.size() + 1);
+    writer.finalize();
+    return path;
+}
+
+static void check_file(const std::string &path, const std::string &compression,
+                       REFERENCES::LOADING loading, BACKEND::TYPE backend)
+{
+    SLOBReader reader;
+    reader.open_file(path.c_str(), loading, backend);
+
+    CHECK(reader.uuid() == "0123456789abcdef");
+    CHECK(reader.compression() == compression);
+    CHECK(reader.ref_count() == ENTRIES.size() + 1);
+    CHECK(reader.blob_count() == ENTRIES.size());
+    CHECK(reader.bin_count() == (ENTRIES.size() + 1) / 2);
+
+    std::map<std::string, std::string> tags;
+    reader.for_each_tag([&](const auto &tag) {
+        tags.insert(tag);
+        return ITERATION::CONTINUE;
+    });
+    CHECK(tags.size() == 2);
+    CHECK(tags["label"] == "Writer test");
+    CHECK(tags["source"] == "");
+
+    std::vector<std::string> content_types;
+    reader.for_each_content_type([&](const std::string &content_type) {
+        content_types.push_back(content_type);
+        return ITERATION::CONTINUE;
+    });
+    CHECK(content_types.size() == 3);
+
+    // A bin is decompressed whole and cached only once missed twice.
+    if (!compression.empty()) {
+        CHECK(reader.item(0, 1) == ENTRIES[1].content);
+        CHECK(reader.bin_cache_stats().entries == 0);
+        CHECK(reader.item(0, 0) == ENTRIES[0].content);
+        CHECK(reader.bin_cache_stats().entries == 1);
+        CHECK(reader.item(0, 1) == ENTRIES[1].content);
+        CHECK(reader.bin_cache_stats().hits == 1);
+    }
+
+    // Every key refers to its item, content and fragment.
+    for (const Entry &entry : ENTRIES) {
+        bool found = false;
+        for (U_INT i = 0; i < reader.ref_count(); i++) {
+            SLOBReference ref = reader.reference(i);
+            if (ref.key != entry.key)
+                continue;
+            found = true;
+            CHECK(ref.fragment == entry.fragment);
+            CHECK(reader.item(ref.bin_index, ref.item_index) == entry.content);
+
+            SLOBStoreItem bin = reader.store_item(ref.bin_index);
+            CHECK(reader.content_type(bin.content_type_ids.at(ref.item_index)) == entry.content_type);
+        }
+        CHECK(found);
+    }
+
+    SLOBDict dict(reader);
+
+    // Lookups ignore case, and match both spellings.
+    std::vector<SLOBReference> matches = dict["BLACK HOLE"];
+    CHECK(matches.size() == 2);
+    for (const SLOBReference &match : matches)
+        CHECK(match.key == "black hole" || match.key == "Black Hole");
+
+    matches = dict["singularity"];
+    CHECK(matches.size() == 1);
+    if (!matches.empty())
+        CHECK(reader.item(matches[0].bin_index, matches[0].item_index) == ENTRIES[0].content);
+
+    CHECK(dict["missing"].empty());
+}
+
+int main()
+{
+    SLOBThreadPool pool(2);
+
+    for (const std::string compression : { "lzma2", "zlib", "" }) {
+        for (SLOBThreadPool *writer_pool : { (SLOBThreadPool *)nullptr, &pool }) {
+            std::string path = write_file(compression, writer_pool);
+            for (REFERENCES::LOADING loading : { REFERENCES::EAGER, REFERENCES::LAZY })
+                for (BACKEND::TYPE backend : { BACKEND::STREAM, BACKEND::MMAP })
+                    check_file(path, compression, loading, backend);
+            std::remove(path.c_str());
+        }
+    }
+
+    return check_result();
+}
@@ -0,0 +1,97 @@
+#include <string>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "slob.h"
+#include "exporter.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] <file.slob>\n"
+              << "\n"
+              << "  -f <format>        jsonl or tsv (default: jsonl)\n"
+              << "  -t <content type>  only items of this content type (repeatable)\n"
+              << "  --from <key>       only keys collating from key\n"
+              << "  --to <key>         only keys collating before key\n"
+              << "  -j <threads>       decompression threads (default: all cores)\n"
+              << "  -o <file>          output file (default: standard output)\n";
+}
+
+// Parse a whole argument as a number that fits the type.
+template <typename T>
+static bool parse_number(const char *value, T &number)
+{
+    const char *end = value + strlen(value);
+    auto [last, error] = std::from_chars(value, end, number);
+    return error == std::errc() && last == end;
+}
+
+int main(int argc, char **argv)
+{
+    EXPORT::FORMAT format = EXPORT::JSONL;
+    std::vector<std::string> content_types;
+    std::string from, to;
+    size_t threads = std::thread::hardware_concurrency();
+    const char *output = nullptr;
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const char *value = argv[arg + 1];
+        if (!strcmp(argv[arg], "-f") && !strcmp(value, "jsonl")) {
+            format = EXPORT::JSONL;
+        } else if (!strcmp(argv[arg], "-f") && !strcmp(value, "tsv")) {
+            format = EXPORT::TSV;
+        } else if (!strcmp(argv[arg], "-t")) {
+            content_types.push_back(value);
+        } else if (!strcmp(argv[arg], "--from")) {
+            from = value;
+        } else if (!strcmp(argv[arg], "--to")) {
+            to = value;
+        } else if (!strcmp(argv[arg], "-j")) {
+            if (!parse_number(value, threads)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[arg], "-o")) {
+            output = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - arg != 1 || threads == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        SLOBReader reader;
+        reader.open_file(argv[arg], REFERENCES::LAZY, BACKEND::MMAP);
+        reader.advise(ACCESS::SEQUENTIAL);
+
+        SLOBThreadPool pool(threads);
+        SLOBExporter exporter(reader, &pool);
+        exporter.set_format(format);
+        exporter.set_content_types(content_types);
+        exporter.set_key_range(from, to);
+
+        std::ofstream file;
+        if (output) {
+            file.open(output, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw std::invalid_argument("SLOB: Could not create export file");
+        }
+
+        std::ios::sync_with_stdio(false);
+        size_t records = exporter.write(output ? file : std::cout);
+        std::cerr << argv[arg] << ": " << records << " records\n";
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
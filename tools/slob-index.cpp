@@ -0,0 +1,75 @@
+#include <string>
+#include <cstring>
+#include <iostream>
+#include "slob.h"
+#include "dictionary.h"
+#include "collation_index.h"
+#include "fuzzy_index.h"
+#include "substring_index.h"
+#include "text_index.h"
+#include "bloom_filter.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <type> <file.slob> [<index>]\n"
+              << "\n"
+              << "  collation  precomputed collation keys (default: <file.slob>"
+              << COLLATION_INDEX_EXTENSION << ")\n"
+              << "  fuzzy      folded keys for fuzzy search (default: <file.slob>"
+              << FUZZY_INDEX_EXTENSION << ")\n"
+              << "  substring  suffix array for substring search (default: <file.slob>"
+              << SUBSTRING_INDEX_EXTENSION << ")\n"
+              << "  text       full-text index of text and HTML items (default: <file.slob>"
+              << TEXT_INDEX_EXTENSION << ")\n"
+              << "  bloom      filter of key prefixes for fast misses (default: <file.slob>"
+              << BLOOM_FILTER_EXTENSION << ")\n";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3 || argc > 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char *file = argv[2];
+
+    try {
+        SLOBReader reader;
+        reader.open_file(file);
+
+        if (type == "collation") {
+            std::string path = argc > 3 ? argv[3] : std::string(file) + COLLATION_INDEX_EXTENSION;
+            CollationKeyList key_list(reader);
+            SLOBCollationIndex::build(reader, key_list, path.c_str());
+            std::cout << path << ": " << reader.ref_count() << " keys\n";
+        } else if (type == "fuzzy") {
+            std::string path = argc > 3 ? argv[3] : std::string(file) + FUZZY_INDEX_EXTENSION;
+            SLOBFuzzyIndex::build(reader, path.c_str());
+            std::cout << path << ": " << reader.ref_count() << " keys\n";
+        } else if (type == "substring") {
+            std::string path = argc > 3 ? argv[3] : std::string(file) + SUBSTRING_INDEX_EXTENSION;
+            SLOBSubstringIndex::build(reader, path.c_str());
+            std::cout << path << ": " << reader.ref_count() << " keys\n";
+        } else if (type == "text") {
+            std::string path = argc > 3 ? argv[3] : std::string(file) + TEXT_INDEX_EXTENSION;
+            SLOBThreadPool pool;
+            SLOBTextIndex::build(reader, path.c_str(), &pool);
+            std::cout << path << ": " << reader.blob_count() << " items\n";
+        } else if (type == "bloom") {
+            std::string path = argc > 3 ? argv[3] : std::string(file) + BLOOM_FILTER_EXTENSION;
+            CollationKeyList key_list(reader);
+            SLOBBloomFilter::build(reader, key_list, path.c_str());
+            std::cout << path << ": " << reader.ref_count() << " keys\n";
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <string>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include "slob.h"
+#include "slob_writer.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] <in.slob> <out.slob>\n"
+              << "\n"
+              << "  -c <compression>  lzma2, zlib or none (default: as <in.slob>)\n"
+              << "  -n <count>        items per bin (default: " << (U_INT)MAX_BIN_ITEM_COUNT << ")\n"
+              << "  -s <bytes>        item bytes per bin (default: " << DEFAULT_BIN_SIZE << ")\n"
+              << "  -j <threads>      compression threads (default: all cores)\n";
+}
+
+// Parse a whole argument as a number that fits the type.
+template <typename T>
+static bool parse_number(const char *value, T &number)
+{
+    const char *end = value + strlen(value);
+    auto [last, error] = std::from_chars(value, end, number);
+    return error == std::errc() && last == end;
+}
+
+int main(int argc, char **argv)
+{
+    const char *compression = nullptr;
+    U_INT bin_item_count = MAX_BIN_ITEM_COUNT;
+    size_t bin_size = DEFAULT_BIN_SIZE;
+    size_t threads = std::thread::hardware_concurrency();
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const char *value = argv[arg + 1];
+        bool valid = true;
+        if (!strcmp(argv[arg], "-c"))
+            compression = value;
+        else if (!strcmp(argv[arg], "-n"))
+            valid = parse_number(value, bin_item_count);
+        else if (!strcmp(argv[arg], "-s"))
+            valid = parse_number(value, bin_size);
+        else if (!strcmp(argv[arg], "-j"))
+            valid = parse_number(value, threads);
+        else
+            valid = false;
+
+        if (!valid) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - arg != 2 || threads == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        SLOBReader reader;
+        reader.open_file(argv[arg]);
+
+        std::string codec = compression ? compression : reader.compression();
+        if (codec == "none")
+            codec.clear();
+
+        SLOBThreadPool pool(threads);
+        SLOBWriter writer(argv[arg + 1], codec, &pool);
+        writer.set_bin_item_count(bin_item_count);
+        writer.set_bin_size(bin_size);
+
+        reader.for_each_tag([&](const auto &tag) {
+            writer.tag(tag.first, tag.second);
+            return ITERATION::CONTINUE;
+        });
+
+        // Id of the first item of every bin in the new file.
+        std::vector<U_INT> bin_items(reader.bin_count());
+        reader.for_each_bin([&](U_INT bin_index, std::shared_ptr<const SLOBStoreItem> bin) {
+            SLOBStorageBin storage_bin(*bin, bin->content_type_ids.size());
+            bin_items[bin_index] = writer.item_count();
+            for (U_INT i = 0; i < storage_bin.size(); i++)
+                writer.add_item(storage_bin.next(), reader.content_type(bin->content_type_ids[i]));
+            return false;
+        }, pool);
+
+        reader.for_each_reference([&](const SLOBReferenceView &ref) {
+            writer.add_reference(ref.key, bin_items.at(ref.bin_index) + ref.item_index, ref.fragment);
+            return ITERATION::CONTINUE;
+        });
+
+        writer.finalize();
+        std::cout << argv[arg + 1] << ": " << writer.ref_count() << " keys, "
+                  << writer.item_count() << " items, " << writer.bin_count() << " bins\n";
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}